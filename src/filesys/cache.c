@@ -0,0 +1,457 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache.
+
+   Every read and write of a file system sector goes through a
+   cache of CACHE_SIZE sectors, so that small reads and writes,
+   and repeated accesses to inodes and directories, do not each
+   cost a disk operation.  When the cache is full, a victim is
+   chosen with the clock algorithm among the entries that nobody
+   is using.
+
+   Writes are write-behind: a modified sector is written to disk
+   when it is evicted, when the flush daemon wakes up every
+   FLUSH_INTERVAL timer ticks, or when the file system is shut
+   down.
+
+   A sector written inside a journal transaction is "logged": it
+   must not go home before the transaction commits, so it is
+   neither evicted nor flushed until the journal calls
+   cache_unlog().
+
+   inode_read_at() asks for the sector after a sequential read
+   with cache_readahead().  The read-ahead daemon reads such
+   sectors into the cache in the background.
+
+   CACHE_SYNC protects which sector each entry holds, and each
+   entry's pin count and accessed bit.  An entry with a nonzero
+   pin count is never evicted, so a thread that pins an entry
+   while holding CACHE_SYNC may then wait for the entry's own
+   lock, which serializes access to its data, without CACHE_SYNC
+   held.  No disk I/O is done with CACHE_SYNC held: a modified
+   victim is pinned under its old sector and written back under
+   its own lock before it is reused. */
+
+/* Number of sectors in the cache. */
+#define CACHE_SIZE 64
+
+/* Timer ticks between flushes of modified sectors. */
+#define FLUSH_INTERVAL (5 * TIMER_FREQ)
+
+/* Maximum number of sectors waiting to be read ahead. */
+#define READAHEAD_QUEUE 16
+
+/* Sector number of an entry that holds no sector. */
+#define NO_SECTOR ((block_sector_t) -1)
+
+/* A cached sector. */
+struct cache_entry
+  {
+    /* Protected by CACHE_SYNC. */
+    block_sector_t sector;      /* Cached sector, or NO_SECTOR. */
+    unsigned pin_cnt;           /* Threads using or waiting for it. */
+    bool accessed;              /* Used since the clock hand passed? */
+
+    /* Protected by LOCK. */
+    struct lock lock;           /* Serializes access to the data. */
+    bool valid;                 /* DATA holds SECTOR's contents? */
+    bool dirty;                 /* DATA newer than the disk? */
+    bool logged;                /* In an uncommitted transaction? */
+    uint8_t data[BLOCK_SECTOR_SIZE]; /* Sector contents. */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+static size_t hand;                 /* Clock hand, an index in CACHE. */
+static struct lock cache_sync;      /* Protects sector assignments. */
+static struct condition unpinned;   /* Signaled when an entry unpins. */
+
+/* Read-ahead queue. */
+static block_sector_t readahead_queue[READAHEAD_QUEUE];
+static size_t readahead_head, readahead_cnt;
+static struct lock readahead_lock;  /* Protects the queue. */
+static struct condition readahead_cond; /* Signaled when queue nonempty. */
+
+/* Statistics. */
+static struct lock stats_lock;          /* Protects the statistics. */
+static long long hit_cnt, miss_cnt;     /* Reads and writes. */
+static long long readahead_reads;       /* Sectors read ahead. */
+static long long flush_cnt;             /* Calls to cache_flush(). */
+static long long flush_writes;          /* Sectors written by flushes. */
+static long long evict_writes;          /* Sectors written on eviction. */
+
+static struct cache_entry *lock_entry (block_sector_t);
+static void unlock_entry (struct cache_entry *);
+static void fill_entry (struct cache_entry *);
+static void write_entry (block_sector_t, const void *, off_t, size_t, bool);
+static void count (long long *);
+static thread_func flush_daemon, readahead_daemon;
+
+/* Initializes the buffer cache and starts its daemons. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  lock_init (&cache_sync);
+  cond_init (&unpinned);
+  lock_init (&readahead_lock);
+  cond_init (&readahead_cond);
+  lock_init (&stats_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      cache[i].sector = NO_SECTOR;
+      lock_init (&cache[i].lock);
+    }
+
+  thread_create ("flushd", PRI_DEFAULT, flush_daemon, NULL);
+  thread_create ("readaheadd", PRI_DEFAULT, readahead_daemon, NULL);
+}
+
+/* Copies SIZE bytes starting at offset OFS in SECTOR into
+   BUFFER. */
+void
+cache_read (block_sector_t sector, void *buffer, off_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = lock_entry (sector);
+  fill_entry (e);
+  memcpy (buffer, e->data + ofs, size);
+  unlock_entry (e);
+}
+
+/* Copies SIZE bytes from BUFFER into SECTOR starting at offset
+   OFS.  The sector reaches the disk later. */
+void
+cache_write (block_sector_t sector, const void *buffer, off_t ofs,
+             size_t size)
+{
+  write_entry (sector, buffer, ofs, size, true);
+}
+
+/* Like cache_write(), but for file data, so that SECTOR is never
+   added to a journal transaction.  A sector that a transaction
+   has logged must not be written this way, or replay could write
+   its logged image over the newer contents. */
+void
+cache_write_data (block_sector_t sector, const void *buffer, off_t ofs,
+                  size_t size)
+{
+  write_entry (sector, buffer, ofs, size, false);
+}
+
+/* Copies SIZE bytes from BUFFER into SECTOR starting at offset
+   OFS, adding SECTOR to the running journal transaction if LOG
+   is true. */
+static void
+write_entry (block_sector_t sector, const void *buffer, off_t ofs,
+             size_t size, bool log)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = lock_entry (sector);
+  if (ofs == 0 && size == BLOCK_SECTOR_SIZE && !e->valid)
+    {
+      /* Overwriting all of it, so don't bother reading it. */
+      e->valid = true;
+      count (&miss_cnt);
+    }
+  else
+    fill_entry (e);
+  memcpy (e->data + ofs, buffer, size);
+  e->dirty = true;
+  if (log && journal_add (sector))
+    e->logged = true;
+  unlock_entry (e);
+}
+
+/* Fills SECTOR with zeros, without reading it first.  Unlike
+   cache_write(), never adds SECTOR to a journal transaction,
+   since it is meant for newly allocated file data. */
+void
+cache_zero (block_sector_t sector)
+{
+  struct cache_entry *e = lock_entry (sector);
+  if (!e->valid)
+    {
+      e->valid = true;
+      count (&miss_cnt);
+    }
+  else
+    count (&hit_cnt);
+  memset (e->data, 0, BLOCK_SECTOR_SIZE);
+  e->dirty = true;
+  unlock_entry (e);
+}
+
+/* Lets SECTOR go home, now that the journal transaction that it
+   was logged in has committed. */
+void
+cache_unlog (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+
+      lock_acquire (&cache_sync);
+      if (e->sector != sector)
+        {
+          lock_release (&cache_sync);
+          continue;
+        }
+      e->pin_cnt++;
+      lock_release (&cache_sync);
+
+      lock_acquire (&e->lock);
+      e->logged = false;
+      unlock_entry (e);
+      return;
+    }
+}
+
+/* Asks for SECTOR to be read into the cache in the background,
+   because it will probably be read soon.  The request is
+   dropped if too many are already waiting. */
+void
+cache_readahead (block_sector_t sector)
+{
+  lock_acquire (&readahead_lock);
+  if (readahead_cnt < READAHEAD_QUEUE)
+    {
+      readahead_queue[(readahead_head + readahead_cnt++) % READAHEAD_QUEUE]
+        = sector;
+      cond_signal (&readahead_cond, &readahead_lock);
+    }
+  lock_release (&readahead_lock);
+}
+
+/* Writes every modified sector in the cache to disk. */
+void
+cache_flush (void)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+
+      lock_acquire (&cache_sync);
+      if (e->sector == NO_SECTOR)
+        {
+          lock_release (&cache_sync);
+          continue;
+        }
+      e->pin_cnt++;
+      lock_release (&cache_sync);
+
+      lock_acquire (&e->lock);
+      if (e->valid && e->dirty && !e->logged)
+        {
+          block_write (fs_device, e->sector, e->data);
+          e->dirty = false;
+          count (&flush_writes);
+        }
+      unlock_entry (e);
+    }
+  count (&flush_cnt);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  long long total;
+
+  lock_acquire (&stats_lock);
+  total = hit_cnt + miss_cnt;
+  printf ("Buffer cache: %lld hits, %lld misses (%lld%% hits), "
+          "%lld sectors read ahead\n",
+          hit_cnt, miss_cnt, total > 0 ? hit_cnt * 100 / total : 0,
+          readahead_reads);
+  printf ("Buffer cache: %lld flushes wrote %lld sectors, "
+          "%lld sectors written on eviction\n",
+          flush_cnt, flush_writes, evict_writes);
+  lock_release (&stats_lock);
+}
+
+/* Returns the entry for SECTOR, assigning one to it if
+   necessary, with its lock held.  The entry's data is valid
+   only if its VALID member is true. */
+static struct cache_entry *
+lock_entry (block_sector_t sector)
+{
+  struct cache_entry *e;
+  size_t i;
+
+  ASSERT (sector != NO_SECTOR);
+
+  lock_acquire (&cache_sync);
+  for (;;)
+    {
+      /* Is it cached already? */
+      for (i = 0; i < CACHE_SIZE; i++)
+        if (cache[i].sector == sector)
+          {
+            e = &cache[i];
+            goto found;
+          }
+
+      /* Find an unused entry to evict.  Sweep twice, to give
+         recently used entries a second chance. */
+      for (i = 0; i < 2 * CACHE_SIZE; i++)
+        {
+          e = &cache[hand];
+          if (e->pin_cnt > 0 || e->logged)
+            {
+              hand = (hand + 1) % CACHE_SIZE;
+              continue;
+            }
+          if (e->accessed)
+            {
+              e->accessed = false;
+              hand = (hand + 1) % CACHE_SIZE;
+              continue;
+            }
+
+          /* Nobody can be holding the lock of an unpinned entry,
+             and nobody can pin it while we hold CACHE_SYNC, so a
+             clean victim can be reused right away. */
+          if (e->sector == NO_SECTOR || !e->valid || !e->dirty)
+            {
+              hand = (hand + 1) % CACHE_SIZE;
+              e->sector = sector;
+              e->valid = false;
+              e->dirty = false;
+              goto found;
+            }
+
+          /* A dirty victim must be written back first.  Keep it
+             pinned under its old sector while we do, so that
+             anyone who wants that sector waits for the write
+             rather than reading stale data from disk, then look
+             again with the hand still on it, since the sector we
+             want may have been cached meanwhile. */
+          e->pin_cnt++;
+          lock_release (&cache_sync);
+
+          lock_acquire (&e->lock);
+          if (e->valid && e->dirty && !e->logged)
+            {
+              block_write (fs_device, e->sector, e->data);
+              e->dirty = false;
+              count (&evict_writes);
+            }
+          unlock_entry (e);
+
+          lock_acquire (&cache_sync);
+          break;
+        }
+
+      /* Every entry is in use.  Wait for one to be released,
+         then look again, since the sector may have been cached
+         meanwhile. */
+      if (i == 2 * CACHE_SIZE)
+        cond_wait (&unpinned, &cache_sync);
+    }
+
+ found:
+  e->pin_cnt++;
+  e->accessed = true;
+  lock_release (&cache_sync);
+
+  lock_acquire (&e->lock);
+  return e;
+}
+
+/* Releases entry E, which was obtained with lock_entry(). */
+static void
+unlock_entry (struct cache_entry *e)
+{
+  lock_release (&e->lock);
+
+  lock_acquire (&cache_sync);
+  if (--e->pin_cnt == 0)
+    cond_signal (&unpinned, &cache_sync);
+  lock_release (&cache_sync);
+}
+
+/* Reads E's sector from disk, unless E already holds it, and
+   counts a hit or a miss.  E's lock must be held. */
+static void
+fill_entry (struct cache_entry *e)
+{
+  if (e->valid)
+    count (&hit_cnt);
+  else
+    {
+      block_read (fs_device, e->sector, e->data);
+      e->valid = true;
+      count (&miss_cnt);
+    }
+}
+
+/* Adds one to statistics counter *CNT. */
+static void
+count (long long *cnt)
+{
+  lock_acquire (&stats_lock);
+  ++*cnt;
+  lock_release (&stats_lock);
+}
+
+/* Commits the journal and writes modified sectors to disk every
+   FLUSH_INTERVAL ticks, so that not too much is lost in a
+   crash. */
+static void
+flush_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      journal_commit ();
+      cache_flush ();
+    }
+}
+
+/* Reads the sectors that cache_readahead() asks for. */
+static void
+readahead_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct cache_entry *e;
+      block_sector_t sector;
+
+      lock_acquire (&readahead_lock);
+      while (readahead_cnt == 0)
+        cond_wait (&readahead_cond, &readahead_lock);
+      sector = readahead_queue[readahead_head];
+      readahead_head = (readahead_head + 1) % READAHEAD_QUEUE;
+      readahead_cnt--;
+      lock_release (&readahead_lock);
+
+      e = lock_entry (sector);
+      if (!e->valid)
+        {
+          block_read (fs_device, e->sector, e->data);
+          e->valid = true;
+          count (&readahead_reads);
+        }
+      unlock_entry (e);
+    }
+}
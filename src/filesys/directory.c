@@ -1,16 +1,49 @@
 #include "filesys/directory.h"
+#include <hash.h>
+#include <round.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Directory formats.
+
+   A directory is a file of directory entries.  Directories made
+   by older versions of this code are plain arrays of entries,
+   searched from start to end.
+
+   A hashed directory starts with a header sector that begins
+   with DIR_MAGIC.  The header is followed by a power-of-2
+   number of buckets, one sector each.  A name normally lives in
+   the bucket its hash selects, so it is found with a single
+   sector read.  If that bucket is full, the name goes in the
+   next bucket with room, wrapping around.  Each bucket counts
+   the entries stored past it in this way, so a search stops at
+   the first bucket with a count of zero.  The directory doubles
+   its bucket count and rehashes once its buckets are 3/4
+   full.
+
+   Lookups, additions, removals, and reads of a directory hold
+   its inode's lock, taken with inode_lock(), so they happen one
+   at a time in any given directory.  A lookup opens the inode it
+   finds before releasing the lock, so that a concurrent removal
+   cannot free the inode first. */
+
+/* Identifies a hashed directory.  A linear directory begins
+   with an entry's sector number, which is much smaller. */
+#define DIR_MAGIC 0x48524944
 
 /* A directory. */
 struct dir 
   {
     struct inode *inode;                /* Backing store. */
     off_t pos;                          /* Current position. */
+    bool hashed;                        /* Hashed or linear? */
   };
 
 /* A single directory entry. */
@@ -21,12 +54,158 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Header of a hashed directory, at its start. */
+struct dir_header
+  {
+    uint32_t magic;                     /* DIR_MAGIC. */
+    uint32_t bucket_cnt;                /* Number of buckets, a power of 2. */
+    uint32_t entry_cnt;                 /* Number of entries in use. */
+  };
+
+/* Number of entries in a bucket. */
+#define BUCKET_ENTRIES (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry) - 1)
+
+/* A bucket of a hashed directory.
+   Must be no more than BLOCK_SECTOR_SIZE bytes long. */
+struct dir_bucket
+  {
+    struct dir_entry entries[BUCKET_ENTRIES]; /* Entries. */
+    uint32_t passed_cnt;                /* Entries stored past this bucket
+                                           because it was full. */
+  };
+
+/* Byte offset, within a bucket, of its `passed_cnt'. */
+#define PASSED_OFS offsetof (struct dir_bucket, passed_cnt)
+
+/* Directory entry cache.
+
+   The cache remembers recent results of dir_lookup(), keyed by
+   the sector of the directory's inode and the name, including
+   names that were not found, so that looking up the same names
+   again need not read the directory.  dir_add() and dir_remove()
+   update the entries for the names that they change, and
+   dir_create() drops every entry for the directory whose sector
+   it reuses.
+
+   A lookup that misses fills the cache after reading the
+   directory.  The fill is dropped if any entry changed in the
+   meantime, since what it read may be out of date. */
+
+/* Maximum number of cached entries. */
+#define DCACHE_SIZE 256
+
+/* A cached directory entry. */
+struct dcache_entry
+  {
+    struct hash_elem hash_elem;         /* Element in `dcache'. */
+    struct list_elem lru_elem;          /* Element in `dcache_lru'. */
+    block_sector_t dir_sector;          /* Sector of directory's inode. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    bool present;                       /* Does the file exist? */
+    block_sector_t inode_sector;        /* File's inode, if PRESENT. */
+  };
+
+static struct hash dcache;              /* Cached entries. */
+static struct list dcache_lru;          /* Least recently used first. */
+static unsigned dcache_gen;             /* Incremented by every change. */
+static struct lock dcache_lock;         /* Protects the above. */
+
+static hash_hash_func dcache_hash;
+static hash_less_func dcache_less;
+
+static bool dcache_get (const struct dir *, const char *name,
+                        bool *present, block_sector_t *inode_sector,
+                        unsigned *gen);
+static void dcache_fill (const struct dir *, const char *name,
+                         bool present, block_sector_t inode_sector,
+                         unsigned gen);
+static void dcache_set (const struct dir *, const char *name,
+                        bool present, block_sector_t inode_sector);
+static void dcache_purge (block_sector_t dir_sector);
+
+/* Initializes the directory module. */
+void
+dir_init (void) 
+{
+  if (!hash_init (&dcache, dcache_hash, dcache_less, NULL))
+    PANIC ("directory entry cache creation failed");
+  list_init (&dcache_lru);
+  lock_init (&dcache_lock);
+}
+
+/* Returns the byte offset of bucket B in a hashed directory. */
+static off_t
+bucket_ofs (uint32_t b)
+{
+  return (off_t) (b + 1) * BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the bucket where NAME belongs in a hashed directory
+   with BUCKET_CNT buckets. */
+static uint32_t
+home_bucket (const char *name, uint32_t bucket_cnt)
+{
+  return hash_string (name) & (bucket_cnt - 1);
+}
+
+/* Reads the 32-bit word at OFS in DIR into *VALUE.  Returns true
+   if successful, false on a short read. */
+static bool
+read_word (const struct dir *dir, off_t ofs, uint32_t *value)
+{
+  return inode_read_at (dir->inode, value, sizeof *value, ofs)
+         == sizeof *value;
+}
+
+/* Writes VALUE as the 32-bit word at OFS in DIR.  Returns true
+   if successful, false on a short write. */
+static bool
+write_word (struct dir *dir, off_t ofs, uint32_t value)
+{
+  return inode_write_at (dir->inode, &value, sizeof value, ofs)
+         == sizeof value;
+}
+
+/* Reads the header of hashed directory DIR into *H.  Returns
+   true if successful, false on failure. */
+static bool
+read_header (const struct dir *dir, struct dir_header *h)
+{
+  return inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+}
+
+/* Writes *H as the header of hashed directory DIR.  Returns true
+   if successful, false on failure. */
+static bool
+write_header (struct dir *dir, const struct dir_header *h)
+{
+  return inode_write_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir dir;
+  struct dir_header h;
+  bool success;
+
+  h.magic = DIR_MAGIC;
+  h.bucket_cnt = 1;
+  while (h.bucket_cnt * BUCKET_ENTRIES * 3 / 4 < entry_cnt)
+    h.bucket_cnt *= 2;
+  h.entry_cnt = 0;
+
+  dcache_purge (sector);
+  if (!inode_create (sector, bucket_ofs (h.bucket_cnt)))
+    return false;
+  dir.inode = inode_open (sector);
+  if (dir.inode == NULL)
+    return false;
+  success = write_header (&dir, &h);
+  inode_close (dir.inode);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -37,8 +216,11 @@ dir_open (struct inode *inode)
   struct dir *dir = calloc (1, sizeof *dir);
   if (inode != NULL && dir != NULL)
     {
+      uint32_t magic;
+
       dir->inode = inode;
       dir->pos = 0;
+      dir->hashed = read_word (dir, 0, &magic) && magic == DIR_MAGIC;
       return dir;
     }
   else
@@ -83,6 +265,53 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+
+/* Searches hashed directory DIR for a file with the given NAME,
+   as for lookup(). */
+static bool
+hashed_lookup (const struct dir *dir, const char *name,
+               struct dir_entry *ep, off_t *ofsp)
+{
+  struct dir_header h;
+  struct dir_bucket *bucket;
+  uint32_t b, i;
+  bool found = false;
+
+  bucket = malloc (sizeof *bucket);
+  if (bucket == NULL || !read_header (dir, &h))
+    goto done;
+
+  b = home_bucket (name, h.bucket_cnt);
+  for (i = 0; i < h.bucket_cnt; i++)
+    {
+      size_t j;
+
+      if (inode_read_at (dir->inode, bucket, sizeof *bucket, bucket_ofs (b))
+          != sizeof *bucket)
+        break;
+      for (j = 0; j < BUCKET_ENTRIES; j++) 
+        {
+          struct dir_entry *e = &bucket->entries[j];
+          if (e->in_use && !strcmp (name, e->name)) 
+            {
+              if (ep != NULL)
+                *ep = *e;
+              if (ofsp != NULL)
+                *ofsp = bucket_ofs (b) + j * sizeof *e;
+              found = true;
+              goto done;
+            }
+        }
+      if (bucket->passed_cnt == 0)
+        break;
+      b = (b + 1) & (h.bucket_cnt - 1);
+    }
+
+ done:
+  free (bucket);
+  return found;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
@@ -98,6 +327,9 @@ lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (dir->hashed)
+    return hashed_lookup (dir, name, ep, ofsp);
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -120,18 +352,154 @@ dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
   struct dir_entry e;
+  block_sector_t inode_sector;
+  bool present;
+  unsigned gen;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  inode_lock (dir->inode);
+  if (!dcache_get (dir, name, &present, &inode_sector, &gen))
+    {
+      present = lookup (dir, name, &e, NULL);
+      inode_sector = present ? e.inode_sector : 0;
+      dcache_fill (dir, name, present, inode_sector, gen);
+    }
+
+  if (present)
+    *inode = inode_open (inode_sector);
   else
     *inode = NULL;
+  inode_unlock (dir->inode);
 
   return *inode != NULL;
 }
 
+/* Stores E in the bucket of hashed directory DIR where its name
+   belongs, using BUCKET as scratch space, and counts it in *H.
+   The directory must have a free entry.  Returns true if
+   successful, false on failure. */
+static bool
+insert (struct dir *dir, struct dir_header *h, const struct dir_entry *e,
+        struct dir_bucket *bucket)
+{
+  uint32_t b, i;
+
+  b = home_bucket (e->name, h->bucket_cnt);
+  for (i = 0; i < h->bucket_cnt; i++)
+    {
+      size_t j;
+
+      if (inode_read_at (dir->inode, bucket, sizeof *bucket, bucket_ofs (b))
+          != sizeof *bucket)
+        return false;
+      for (j = 0; j < BUCKET_ENTRIES; j++)
+        if (!bucket->entries[j].in_use)
+          {
+            off_t ofs = bucket_ofs (b) + j * sizeof *e;
+            if (inode_write_at (dir->inode, e, sizeof *e, ofs) != sizeof *e)
+              return false;
+            h->entry_cnt++;
+            return true;
+          }
+
+      /* Bucket is full.  Note that we are passing it. */
+      if (!write_word (dir, bucket_ofs (b) + PASSED_OFS,
+                       bucket->passed_cnt + 1))
+        return false;
+      b = (b + 1) & (h->bucket_cnt - 1);
+    }
+  NOT_REACHED ();
+}
+
+/* Doubles the number of buckets in hashed directory DIR, whose
+   header is *H, and redistributes its entries, using BUCKET as
+   scratch space.  Returns true if successful, false on
+   failure.  If the directory cannot be grown, it is left
+   unchanged. */
+static bool
+rehash (struct dir *dir, struct dir_header *h, struct dir_bucket *bucket)
+{
+  struct dir_entry *entries;
+  uint32_t old_cnt = h->bucket_cnt;
+  size_t entry_cnt = 0;
+  uint32_t b;
+  size_t i;
+  bool success = false;
+
+  /* Gather the entries.  Write each old bucket back unchanged,
+     so that one that was never written, and is still a hole in
+     the file, gets a sector now. */
+  entries = malloc (h->entry_cnt * sizeof *entries);
+  if (entries == NULL && h->entry_cnt > 0)
+    return false;
+  for (b = 0; b < old_cnt; b++)
+    {
+      if (inode_read_at (dir->inode, bucket, sizeof *bucket, bucket_ofs (b))
+          != sizeof *bucket
+          || inode_write_at (dir->inode, bucket, sizeof *bucket,
+                             bucket_ofs (b)) != sizeof *bucket)
+        goto done;
+      for (i = 0; i < BUCKET_ENTRIES; i++)
+        if (bucket->entries[i].in_use && entry_cnt < h->entry_cnt)
+          entries[entry_cnt++] = bucket->entries[i];
+    }
+
+  /* Write every new bucket as well.  With all of the buckets
+     allocated before any old one is emptied, running out of disk
+     space leaves the directory intact. */
+  memset (bucket, 0, sizeof *bucket);
+  for (b = old_cnt; b < 2 * old_cnt; b++)
+    if (inode_write_at (dir->inode, bucket, sizeof *bucket, bucket_ofs (b))
+        != sizeof *bucket)
+      goto done;
+
+  /* Empty the old buckets and insert everything again.  This
+     only writes sectors allocated above. */
+  for (b = 0; b < old_cnt; b++)
+    if (inode_write_at (dir->inode, bucket, sizeof *bucket, bucket_ofs (b))
+        != sizeof *bucket)
+      goto done;
+  h->bucket_cnt = 2 * old_cnt;
+  h->entry_cnt = 0;
+  for (i = 0; i < entry_cnt; i++)
+    if (!insert (dir, h, &entries[i], bucket))
+      goto done;
+  success = true;
+
+ done:
+  free (entries);
+  return success;
+}
+
+/* Adds E to hashed directory DIR, growing it if necessary.
+   Returns true if successful, false on failure. */
+static bool
+hashed_add (struct dir *dir, const struct dir_entry *e)
+{
+  struct dir_header h;
+  struct dir_bucket *bucket;
+  bool success = false;
+
+  bucket = malloc (sizeof *bucket);
+  if (bucket == NULL)
+    return false;
+  if (read_header (dir, &h))
+    {
+      success = ((h.entry_cnt + 1 <= h.bucket_cnt * BUCKET_ENTRIES * 3 / 4
+                  || rehash (dir, &h, bucket))
+                 && insert (dir, &h, e, bucket));
+
+      /* Write the header even on failure, since a rehash that
+         failed part way through has changed it. */
+      if (!write_header (dir, &h))
+        success = false;
+    }
+  free (bucket);
+  return success;
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
@@ -143,6 +511,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
   struct dir_entry e;
   off_t ofs;
+  bool present;
   bool success = false;
 
   ASSERT (dir != NULL);
@@ -152,10 +521,25 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  journal_begin (DIR_ADD_SECTORS);
+  inode_lock (dir->inode);
+
   /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  if (!dcache_get (dir, name, &present, NULL, NULL))
+    present = lookup (dir, name, NULL, NULL);
+  if (present)
     goto done;
 
+  if (dir->hashed)
+    {
+      memset (&e, 0, sizeof e);
+      e.in_use = true;
+      strlcpy (e.name, name, sizeof e.name);
+      e.inode_sector = inode_sector;
+      success = hashed_add (dir, &e);
+      goto done;
+    }
+
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
      current end-of-file.
@@ -175,9 +559,49 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
+  if (success)
+    dcache_set (dir, name, true, inode_sector);
+  else if (!present)
+    {
+      /* A rehash that failed part way through reinserting, which
+         only running out of memory can cause, may have lost
+         entries. */
+      dcache_purge (inode_get_inumber (dir->inode));
+    }
+  inode_unlock (dir->inode);
+  journal_end ();
   return success;
 }
 
+/* Accounts for the removal of the entry named NAME at byte offset
+   OFS in hashed directory DIR, by uncounting it from the buckets
+   that it was stored past and from the header.  Returns true if
+   successful, false on failure. */
+static bool
+hashed_remove (struct dir *dir, const char *name, off_t ofs)
+{
+  struct dir_header h;
+  uint32_t b, last;
+
+  if (!read_header (dir, &h))
+    return false;
+
+  last = ofs / BLOCK_SECTOR_SIZE - 1;
+  for (b = home_bucket (name, h.bucket_cnt); b != last;
+       b = (b + 1) & (h.bucket_cnt - 1))
+    {
+      off_t passed_ofs = bucket_ofs (b) + PASSED_OFS;
+      uint32_t passed_cnt;
+
+      if (!read_word (dir, passed_ofs, &passed_cnt)
+          || !write_word (dir, passed_ofs, passed_cnt - 1))
+        return false;
+    }
+
+  h.entry_cnt--;
+  return write_header (dir, &h);
+}
+
 /* Removes any entry for NAME in DIR.
    Returns true if successful, false on failure,
    which occurs only if there is no file with the given NAME. */
@@ -192,6 +616,9 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  journal_begin (DIR_REMOVE_SECTORS);
+  inode_lock (dir->inode);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -205,13 +632,18 @@ dir_remove (struct dir *dir, const char *name)
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_set (dir, name, false, 0);
+  if (dir->hashed && !hashed_remove (dir, name, ofs))
+    goto done;
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  inode_unlock (dir->inode);
   inode_close (inode);
+  journal_end ();
   return success;
 }
 
@@ -222,15 +654,186 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool success = false;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  inode_lock (dir->inode);
+  for (;;)
     {
+      /* Skip a hashed directory's header and the tail of each
+         bucket. */
+      if (dir->hashed)
+        {
+          if (dir->pos < bucket_ofs (0))
+            dir->pos = bucket_ofs (0);
+          else if (dir->pos % BLOCK_SECTOR_SIZE >= (off_t) PASSED_OFS)
+            dir->pos = ROUND_UP (dir->pos, BLOCK_SECTOR_SIZE);
+        }
+
+      if (inode_read_at (dir->inode, &e, sizeof e, dir->pos) != sizeof e)
+        break;
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          success = true;
+          break;
         } 
     }
-  return false;
+  inode_unlock (dir->inode);
+  return success;
+}
+
+/* Returns the cached entry for NAME in the directory whose inode
+   is in DIR_SECTOR, or a null pointer if there is none.  Marks
+   the entry as most recently used.  DCACHE_LOCK must be held. */
+static struct dcache_entry *
+dcache_find (block_sector_t dir_sector, const char *name)
+{
+  struct dcache_entry key, *d;
+  struct hash_elem *e;
+
+  key.dir_sector = dir_sector;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dcache, &key.hash_elem);
+  if (e == NULL)
+    return NULL;
+
+  d = hash_entry (e, struct dcache_entry, hash_elem);
+  list_remove (&d->lru_elem);
+  list_push_back (&dcache_lru, &d->lru_elem);
+  return d;
+}
+
+/* Records in the cache whether NAME is PRESENT in the directory
+   whose inode is in DIR_SECTOR, and if so that its inode is in
+   INODE_SECTOR.  Reuses the least recently used entry if the
+   cache is full.  DCACHE_LOCK must be held. */
+static void
+dcache_store (block_sector_t dir_sector, const char *name,
+              bool present, block_sector_t inode_sector)
+{
+  struct dcache_entry *d = dcache_find (dir_sector, name);
+
+  if (d == NULL)
+    {
+      if (hash_size (&dcache) >= DCACHE_SIZE)
+        {
+          struct list_elem *e = list_pop_front (&dcache_lru);
+          d = list_entry (e, struct dcache_entry, lru_elem);
+          hash_delete (&dcache, &d->hash_elem);
+        }
+      else
+        {
+          d = malloc (sizeof *d);
+          if (d == NULL)
+            return;
+        }
+      d->dir_sector = dir_sector;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dcache, &d->hash_elem);
+      list_push_back (&dcache_lru, &d->lru_elem);
+    }
+  d->present = present;
+  d->inode_sector = inode_sector;
+}
+
+/* Looks up NAME in DIR in the cache.  On a hit, returns true and
+   stores whether the file is present in *PRESENT and, if so, the
+   sector of its inode in *INODE_SECTOR.  On a miss, returns false
+   and stores in *GEN a value to pass to dcache_fill().  Any of
+   the pointers may be null. */
+static bool
+dcache_get (const struct dir *dir, const char *name,
+            bool *present, block_sector_t *inode_sector, unsigned *gen)
+{
+  struct dcache_entry *d;
+
+  lock_acquire (&dcache_lock);
+  d = dcache_find (inode_get_inumber (dir->inode), name);
+  if (d != NULL)
+    {
+      if (present != NULL)
+        *present = d->present;
+      if (inode_sector != NULL)
+        *inode_sector = d->inode_sector;
+    }
+  else if (gen != NULL)
+    *gen = dcache_gen;
+  lock_release (&dcache_lock);
+
+  return d != NULL;
+}
+
+/* Records the result of looking up NAME in DIR on disk after
+   dcache_get() missed and returned GEN, unless the cache has
+   changed since then. */
+static void
+dcache_fill (const struct dir *dir, const char *name,
+             bool present, block_sector_t inode_sector, unsigned gen)
+{
+  lock_acquire (&dcache_lock);
+  if (gen == dcache_gen)
+    dcache_store (inode_get_inumber (dir->inode), name,
+                  present, inode_sector);
+  lock_release (&dcache_lock);
+}
+
+/* Records that NAME has just been added to DIR, with its inode
+   in INODE_SECTOR, if PRESENT is true, or removed from DIR if
+   PRESENT is false. */
+static void
+dcache_set (const struct dir *dir, const char *name,
+            bool present, block_sector_t inode_sector)
+{
+  lock_acquire (&dcache_lock);
+  dcache_gen++;
+  dcache_store (inode_get_inumber (dir->inode), name,
+                present, inode_sector);
+  lock_release (&dcache_lock);
+}
+
+/* Drops every cached entry for the directory whose inode is in
+   DIR_SECTOR. */
+static void
+dcache_purge (block_sector_t dir_sector)
+{
+  struct list_elem *e, *next;
+
+  lock_acquire (&dcache_lock);
+  dcache_gen++;
+  for (e = list_begin (&dcache_lru); e != list_end (&dcache_lru); e = next)
+    {
+      struct dcache_entry *d = list_entry (e, struct dcache_entry, lru_elem);
+      next = list_next (e);
+      if (d->dir_sector == dir_sector)
+        {
+          list_remove (&d->lru_elem);
+          hash_delete (&dcache, &d->hash_elem);
+          free (d);
+        }
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Returns a hash value for cached entry E. */
+static unsigned
+dcache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dcache_entry *d = hash_entry (e, struct dcache_entry,
+                                             hash_elem);
+  return hash_string (d->name) ^ hash_int (d->dir_sector);
+}
+
+/* Returns true if cached entry A precedes cached entry B. */
+static bool
+dcache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dcache_entry *a = hash_entry (a_, struct dcache_entry,
+                                             hash_elem);
+  const struct dcache_entry *b = hash_entry (b_, struct dcache_entry,
+                                             hash_elem);
+  if (a->dir_sector != b->dir_sector)
+    return a->dir_sector < b->dir_sector;
+  return strcmp (a->name, b->name) < 0;
 }
@@ -13,6 +13,8 @@
 
 struct inode;
 
+void dir_init (void);
+
 /* Opening and closing directories. */
 bool dir_create (block_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
@@ -27,4 +29,10 @@ bool dir_add (struct dir *, const char *name, block_sector_t);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
 
+/* Most sectors that dir_add() and dir_remove() log, for
+   journal_begin().  An addition that rehashes the directory
+   may log more. */
+#define DIR_ADD_SECTORS 16
+#define DIR_REMOVE_SECTORS 8
+
 #endif /* filesys/directory.h */
@@ -2,9 +2,11 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "filesys/directory.h"
 
 /* Partition that contains the file system. */
@@ -21,12 +23,15 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
   inode_init ();
+  dir_init ();
   free_map_init ();
 
   if (format) 
     do_format ();
 
+  journal_open ();
   free_map_open ();
 }
 
@@ -35,7 +40,9 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  journal_commit ();
   free_map_close ();
+  journal_close ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -46,14 +53,20 @@ bool
 filesys_create (const char *name, off_t initial_size) 
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+  struct dir *dir;
+  bool success;
+
+  /* The free map, the new inode, and the directory. */
+  journal_begin (2 + DIR_ADD_SECTORS);
+  dir = dir_open_root ();
+  success = (dir != NULL
+             && free_map_allocate (1, &inode_sector)
+             && inode_create (inode_sector, initial_size)
+             && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
+  journal_end ();
 
   return success;
 }
@@ -83,9 +96,14 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  struct dir *dir;
+  bool success;
+
+  journal_begin (DIR_REMOVE_SECTORS);
+  dir = dir_open_root ();
+  success = dir != NULL && dir_remove (dir, name);
   dir_close (dir); 
+  journal_end ();
 
   return success;
 }
@@ -95,6 +113,7 @@ static void
 do_format (void)
 {
   printf ("Formatting file system...");
+  journal_create ();
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
@@ -1,13 +1,43 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/* Protects the free map and FREE_MAP_DIRTY.  It is held while
+   the free map file is written, so writing the file must never
+   allocate a sector.  The file is written in full when it is
+   created, which allocates all of its sectors. */
+static struct lock free_map_lock;
+
+/* Free map file sectors whose contents on disk are out of date,
+   one bit per sector of the file.
+
+   Allocations are written to the file as soon as they are made,
+   but only the file sectors that they change.  This way a sector
+   is never in use on disk while the free map on disk says that
+   it is free, even if the system crashes.  Releases are merely
+   recorded here and written later, together with the next
+   allocation that changes the same file sector or when the free
+   map is closed.  A crash in between leaves the released sectors
+   marked as in use, which wastes them but is otherwise
+   harmless. */
+static struct bitmap *free_map_dirty;
+
+/* Number of sectors whose bits fit in one sector of the free map
+   file. */
+#define BITS_PER_SECTOR (BLOCK_SECTOR_SIZE * 8)
+
+static void mark_dirty (block_sector_t, size_t cnt);
+static bool write_dirty (block_sector_t, size_t cnt);
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
@@ -17,6 +47,13 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+
+  free_map_dirty = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                                BLOCK_SECTOR_SIZE));
+  if (free_map_dirty == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+  lock_init (&free_map_lock);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,26 +64,69 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  block_sector_t sector;
+
+  lock_acquire (&free_map_lock);
+  sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+      && !write_dirty (sector, cnt))
     {
       bitmap_set_multiple (free_map, sector, cnt, false); 
       sector = BITMAP_ERROR;
     }
+  lock_release (&free_map_lock);
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Allocates up to CNT consecutive sectors starting at SECTOR,
+   stopping at the first one that is already in use.  Returns the
+   number of sectors allocated, which is 0 if SECTOR is in use or
+   if the free_map file could not be written. */
+size_t
+free_map_extend (block_sector_t sector, size_t cnt)
+{
+  size_t n = 0;
+
+  lock_acquire (&free_map_lock);
+  while (n < cnt && sector + n < bitmap_size (free_map)
+         && !bitmap_test (free_map, sector + n))
+    n++;
+  if (n > 0)
+    {
+      bitmap_set_multiple (free_map, sector, n, true);
+      if (free_map_file != NULL && !write_dirty (sector, n))
+        {
+          bitmap_set_multiple (free_map, sector, n, false);
+          n = 0;
+        }
+    }
+  lock_release (&free_map_lock);
+  return n;
+}
+
+/* Releases CNT sectors starting at SECTOR.  They become
+   available for use at once if there is no journal, otherwise
+   when the running journal transaction commits. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  ASSERT (bitmap_all (free_map, sector, cnt));
+  if (!journal_release (sector, cnt))
+    free_map_free (sector, cnt);
+}
+
+/* Makes CNT sectors starting at SECTOR available for use. */
+void
+free_map_free (block_sector_t sector, size_t cnt)
+{
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_dirty (sector, cnt);
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -64,6 +144,9 @@ free_map_open (void)
 void
 free_map_close (void) 
 {
+  lock_acquire (&free_map_lock);
+  write_dirty (0, bitmap_size (free_map));
+  lock_release (&free_map_lock);
   file_close (free_map_file);
 }
 
@@ -72,14 +155,64 @@ free_map_close (void)
 void
 free_map_create (void) 
 {
+  struct file *file;
+
   /* Create inode. */
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
     PANIC ("free map creation failed");
 
-  /* Write bitmap to file. */
-  free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
+  /* Write bitmap to file.  The file is a hole until then, so
+     writing it allocates its sectors.  Don't set FREE_MAP_FILE
+     until afterward, so that those allocations don't try to
+     write the file too. */
+  file = file_open (inode_open (FREE_MAP_SECTOR));
+  if (file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
+  if (!bitmap_write (free_map, file))
     PANIC ("can't write free map");
+  free_map_file = file;
+}
+
+/* Records that the bits for CNT sectors starting at SECTOR have
+   changed in memory. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+
+  bitmap_set_multiple (free_map_dirty, first, last - first + 1, true);
+}
+
+/* Marks the bits for CNT sectors starting at SECTOR as changed,
+   then writes every dirty free map file sector that holds any of
+   them, merging runs of adjacent dirty sectors into single
+   writes.  Returns true if successful, false otherwise. */
+static bool
+write_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+  size_t i = first;
+
+  mark_dirty (sector, cnt);
+  while (i <= last)
+    {
+      size_t start = bitmap_scan (free_map_dirty, i, 1, true);
+      size_t end;
+
+      if (start == BITMAP_ERROR || start > last)
+        break;
+      for (end = start + 1; end <= last; end++)
+        if (!bitmap_test (free_map_dirty, end))
+          break;
+
+      if (!bitmap_write_part (free_map, free_map_file,
+                              start * BLOCK_SECTOR_SIZE,
+                              (end - start) * BLOCK_SECTOR_SIZE))
+        return false;
+      bitmap_set_multiple (free_map_dirty, start, end - start, false);
+      i = end;
+    }
+  return true;
 }
@@ -1,25 +1,99 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
+#include <stddef.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of extents stored in the inode itself. */
+#define INODE_EXTENTS 41
+
+/* Number of extents stored in an overflow block. */
+#define BLOCK_EXTENTS 42
+
+/* A run of consecutive data sectors.
+
+   A file's data is described by a list of extents in order of
+   file position.  The first INODE_EXTENTS extents are in the
+   inode, and any more are in a chain of overflow blocks.
+
+   Files are sparse: a file sector that no extent covers is a
+   hole, which reads as zeros and has no disk sector.  Creating a
+   file or writing past its end only sets its length, and a hole
+   gets disk sectors when it is first written.  Writes grow the
+   extent just before the hole when the sectors after it are
+   free, so most files need only a few extents and their I/O
+   stays sequential.
+
+   A file of INLINE_MAX bytes or less that has no extents keeps
+   its data inline, in the inode in place of the extents, so that
+   reading it takes no more than reading its inode.  That is how
+   every file starts out.  When a write takes the file past
+   INLINE_MAX bytes, the data moves to a sector of its own. */
+struct extent
+  {
+    uint32_t ofs;                       /* First file sector covered. */
+    block_sector_t start;               /* First disk sector. */
+    uint32_t length;                    /* Number of sectors. */
+  };
+
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t sector_cnt;                /* Number of allocated data sectors. */
+    uint32_t extent_cnt;                /* Number of extents. */
+    block_sector_t overflow;            /* First overflow block, or 0. */
+    struct extent extents[INODE_EXTENTS]; /* First extents, or inline data. */
+  };
+
+/* Maximum size of an inline file, and the offset of its data
+   within its inode. */
+#define INLINE_MAX (INODE_EXTENTS * sizeof (struct extent))
+#define INLINE_OFS offsetof (struct inode_disk, extents)
+
+/* Overflow block of extents.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.  Sector 0 holds
+   the free map's inode, so it is never an overflow block. */
+struct extent_block
+  {
+    block_sector_t next;                /* Next overflow block, or 0. */
+    uint32_t unused;                    /* Not used. */
+    struct extent extents[BLOCK_EXTENTS]; /* More extents. */
   };
 
+/* Returns true if DISK's data is inline, false otherwise.  A
+   file's data never becomes inline again once it is not. */
+static inline bool
+is_inline (const struct inode_disk *disk)
+{
+  return disk->extent_cnt == 0 && disk->length <= (off_t) INLINE_MAX;
+}
+
+/* Maximum number of sectors to allocate at once for a write
+   into a hole.  They are zeroed in the buffer cache before the
+   write fills them in, so this must be small compared to the
+   size of the cache. */
+#define ALLOCATE_MAX 8
+
+/* Most sectors that allocating sectors for a hole logs, for
+   journal_begin(): the inode, the free map sectors for the data
+   and for a new extent block, and the new block and the one
+   that links to it.  Inserting an extent ahead of extents in
+   extent blocks moves them, which may log more. */
+#define ALLOCATE_SECTORS 8
+
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
 static inline size_t
@@ -28,47 +102,463 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
+/* In-memory inode.
+
+   Reads and writes of file data take no lock of their own beyond
+   those of the buffer cache, so they proceed in parallel, even
+   within a single file.  They only look up sectors in DATA's
+   extents, which LOCK protects: readers hold it for reading
+   while they search, and a write into a hole holds it for
+   writing while it allocates sectors and adds them to the
+   extents.  A sector is zeroed before its extent is added, so
+   nobody sees what it held before.  No lock is held while data
+   is copied to or from the caller's buffer, which may be in user
+   memory and fault: data passes through a bounce buffer, and
+   only copies between the bounce buffer and the cache happen
+   under a cache entry's lock.
+
+   A write past end of file also holds EXTEND_LOCK throughout,
+   so that such writes happen one at a time, and sets the new
+   length only after it has written the data, so that a
+   concurrent reader never sees bytes that have not been written
+   yet.
+
+   The data of an inline file is kept up to date only in the
+   buffer cache's copy of the inode's sector, not in DATA, and is
+   read and written under LOCK through a buffer on the stack.
+
+   DIR_LOCK serializes operations on a directory.  It is used
+   only by the directory code, through inode_lock() and
+   inode_unlock().
+
+   A thread that takes LOCK or DIR_LOCK must call journal_begin()
+   first, if at all, because a thread waiting in journal_begin()
+   for a commit holds up every thread in the transaction that
+   waits for a lock it holds.  EXTEND_LOCK is taken before
+   journal_begin(), which is safe because nobody waits for it
+   inside a transaction: directories are changed only inside
+   transactions, but one at a time under DIR_LOCK. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in `open_inodes'. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    off_t read_pos;                     /* Where the last read ended. */
+    struct rwlock lock;                 /* Protects DATA's extents. */
+    struct lock extend_lock;            /* Held by a write past EOF. */
+    struct lock dir_lock;               /* Serializes directory operations. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Returns the overflow block of DISK that holds extent IDX. */
+static block_sector_t
+overflow_block (const struct inode_disk *disk, size_t idx)
+{
+  block_sector_t sector = disk->overflow;
+  size_t i;
+
+  ASSERT (idx >= INODE_EXTENTS);
+
+  for (i = 0; i < (idx - INODE_EXTENTS) / BLOCK_EXTENTS; i++)
+    cache_read (sector, &sector, offsetof (struct extent_block, next),
+                sizeof sector);
+  ASSERT (sector != 0);
+  return sector;
+}
+
+/* Returns the byte offset of extent IDX, which must not be one of
+   those in the inode, within its overflow block. */
+static off_t
+extent_ofs (size_t idx)
+{
+  return (offsetof (struct extent_block, extents)
+          + (idx - INODE_EXTENTS) % BLOCK_EXTENTS * sizeof (struct extent));
+}
+
+/* Reads extent IDX of DISK into *E. */
+static void
+get_extent (const struct inode_disk *disk, size_t idx, struct extent *e)
+{
+  ASSERT (idx < disk->extent_cnt);
+
+  if (idx < INODE_EXTENTS)
+    *e = disk->extents[idx];
+  else
+    cache_read (overflow_block (disk, idx), e, extent_ofs (idx), sizeof *e);
+}
+
+/* Stores *E as extent IDX of DISK, which must be an existing
+   extent or the one just after the last.  Returns true if
+   successful, false if a new overflow block was needed and could
+   not be allocated. */
+static bool
+put_extent (struct inode_disk *disk, size_t idx, const struct extent *e)
+{
+  block_sector_t sector;
+
+  ASSERT (idx <= disk->extent_cnt);
+
+  if (idx < INODE_EXTENTS)
+    {
+      disk->extents[idx] = *e;
+      return true;
+    }
+
+  if (idx == disk->extent_cnt && (idx - INODE_EXTENTS) % BLOCK_EXTENTS == 0)
+    {
+      /* First extent in a new overflow block.  Add the block to
+         the end of the chain. */
+      static struct extent_block zeros;
+
+      if (!free_map_allocate (1, &sector))
+        return false;
+      cache_write (sector, &zeros, 0, sizeof zeros);
+      if (idx == INODE_EXTENTS)
+        disk->overflow = sector;
+      else
+        cache_write (overflow_block (disk, idx - BLOCK_EXTENTS), &sector,
+                     offsetof (struct extent_block, next), sizeof sector);
+    }
+  else
+    sector = overflow_block (disk, idx);
+  cache_write (sector, e, extent_ofs (idx), sizeof *e);
+  return true;
+}
+
+/* Searches DISK for the extent that covers FILE_SECTOR.  If
+   there is one, stores its index into *IDX and it into *E and
+   returns true.  Otherwise, FILE_SECTOR is in a hole, and stores
+   the index of the first extent after the hole into *IDX and
+   returns false. */
+static bool
+find_extent (const struct inode_disk *disk, uint32_t file_sector,
+             size_t *idx, struct extent *e)
+{
+  size_t lo = 0;
+  size_t hi = disk->extent_cnt;
+
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+
+      get_extent (disk, mid, e);
+      if (file_sector < e->ofs)
+        hi = mid;
+      else if (file_sector >= e->ofs + e->length)
+        lo = mid + 1;
+      else
+        {
+          *idx = mid;
+          return true;
+        }
+    }
+  *idx = lo;
+  return false;
+}
+
+/* Inserts *E into DISK as extent IDX, moving the extents from
+   IDX onward up by one.  Returns true if successful, false if a
+   new overflow block was needed and could not be allocated, in
+   which case DISK is unchanged. */
+static bool
+insert_extent (struct inode_disk *disk, size_t idx, const struct extent *e)
+{
+  struct extent moved;
+  size_t i;
+
+  ASSERT (idx <= disk->extent_cnt);
+
+  if (idx == disk->extent_cnt)
+    moved = *e;
+  else
+    get_extent (disk, disk->extent_cnt - 1, &moved);
+  if (!put_extent (disk, disk->extent_cnt, &moved))
+    return false;
+  disk->extent_cnt++;
+
+  for (i = disk->extent_cnt - 2; i > idx && i < disk->extent_cnt; i--)
+    {
+      get_extent (disk, i - 1, &moved);
+      put_extent (disk, i, &moved);
+    }
+  if (idx < disk->extent_cnt - 1)
+    put_extent (disk, idx, e);
+  return true;
+}
+
+/* Allocates disk sectors for up to CNT sectors of the hole in
+   DISK that starts at FILE_SECTOR, stopping at the end of the
+   hole.  Tries to place them right after the extent before the
+   hole, so that the file stays contiguous.  Stores the first new
+   disk sector into *START and returns the number allocated,
+   which is 0 if the disk is full.  Either way, the caller must
+   write DISK back. */
+static size_t
+allocate (struct inode_disk *disk, uint32_t file_sector, size_t cnt,
+          block_sector_t *start)
+{
+  struct extent e;
+  size_t idx;
+  size_t n;
+
+  if (find_extent (disk, file_sector, &idx, &e))
+    NOT_REACHED ();
+
+  /* Stop at the extent after the hole. */
+  if (idx < disk->extent_cnt)
+    {
+      get_extent (disk, idx, &e);
+      if (cnt > e.ofs - file_sector)
+        cnt = e.ofs - file_sector;
+    }
+
+  /* Grow the extent before the hole in place if we can. */
+  if (idx > 0)
+    {
+      get_extent (disk, idx - 1, &e);
+      if (e.ofs + e.length == file_sector)
+        {
+          *start = e.start + e.length;
+          n = free_map_extend (*start, cnt);
+          if (n > 0)
+            {
+              e.length += n;
+              put_extent (disk, idx - 1, &e);
+              disk->sector_cnt += n;
+              return n;
+            }
+        }
+    }
+
+  /* Otherwise start a new extent, as long as possible. */
+  for (n = cnt; n > 0; n /= 2)
+    if (free_map_allocate (n, start))
+      break;
+  if (n == 0)
+    return 0;
+
+  e.ofs = file_sector;
+  e.start = *start;
+  e.length = n;
+  if (!insert_extent (disk, idx, &e))
+    {
+      free_map_release (*start, n);
+      return 0;
+    }
+  disk->sector_cnt += n;
+  return n;
+}
+
+/* Frees all of DISK's data sectors and overflow blocks. */
+static void
+release_sectors (struct inode_disk *disk)
+{
+  block_sector_t sector;
+  size_t i;
+
+  for (i = 0; i < disk->extent_cnt; i++)
+    {
+      struct extent e;
+
+      get_extent (disk, i, &e);
+      free_map_release (e.start, e.length);
+    }
+
+  for (sector = disk->overflow; sector != 0; )
+    {
+      block_sector_t next;
+
+      cache_read (sector, &next, offsetof (struct extent_block, next),
+                  sizeof next);
+      free_map_release (sector, 1);
+      sector = next;
+    }
+}
+
+/* Writes INODE's in-memory copy of its disk inode to its
+   sector.  For an inline file, writes only the members before
+   the data, which is kept up to date only in the buffer cache.
+   LOCK must be held for writing. */
+static void
+write_inode (struct inode *inode)
+{
+  size_t size = is_inline (&inode->data) ? INLINE_OFS : BLOCK_SECTOR_SIZE;
+
+  ASSERT (rwlock_held_for_write (&inode->lock));
+  cache_write (inode->sector, &inode->data, 0, size);
+}
+
+/* If INODE's data is inline, reads up to SIZE bytes of it
+   starting at OFFSET into BUFFER, stores the number of bytes
+   read into *BYTES_READ, and returns true.  Otherwise, returns
+   false. */
+static bool
+read_inline (struct inode *inode, void *buffer, off_t size, off_t offset,
+             off_t *bytes_read)
+{
+  uint8_t data[INLINE_MAX];
+  off_t n = 0;
+  bool success;
+
+  if (!is_inline (&inode->data))
+    return false;
+
+  rwlock_acquire_read (&inode->lock);
+  success = is_inline (&inode->data);
+  if (success && size > 0 && offset < inode->data.length)
+    {
+      n = inode->data.length - offset;
+      if (n > size)
+        n = size;
+      cache_read (inode->sector, data, INLINE_OFS + offset, n);
+    }
+  rwlock_release_read (&inode->lock);
+
+  /* BUFFER may be in user memory and fault, so copy it there
+     without holding the lock. */
+  if (success)
+    {
+      memcpy (buffer, data, n);
+      *bytes_read = n;
+    }
+  return success;
+}
+
+/* If INODE's data is inline and will still fit after writing
+   SIZE bytes at OFFSET, writes them from BUFFER and returns
+   true.  Otherwise, returns false.  If the write may go past
+   end of file, the caller must hold EXTEND_LOCK.
+
+   Inline data lives in the inode's sector, which transactions
+   log, so every write to it is logged too.  Otherwise a logged
+   image of the sector could be replayed over newer data. */
+static bool
+write_inline (struct inode *inode, const void *buffer, off_t size,
+              off_t offset)
+{
+  uint8_t data[INLINE_MAX];
+  bool success;
+
+  if (!is_inline (&inode->data) || offset + size > (off_t) INLINE_MAX)
+    return false;
+
+  /* BUFFER may be in user memory and fault, so copy it out
+     before taking the lock. */
+  memcpy (data, buffer, size);
+
+  journal_begin (1);
+  rwlock_acquire_write (&inode->lock);
+  success = is_inline (&inode->data);
+  if (success)
+    {
+      cache_write (inode->sector, data, INLINE_OFS + offset, size);
+      if (offset + size > inode->data.length)
+        {
+          inode->data.length = offset + size;
+          write_inode (inode);
+        }
+    }
+  rwlock_release_write (&inode->lock);
+  journal_end ();
+  return success;
+}
+
+/* Moves INODE's data, if it is inline, to a data sector of its
+   own, so that the file can grow past INLINE_MAX bytes.  Returns
+   true if successful, false if memory or disk allocation fails.
+   The caller must hold EXTEND_LOCK. */
+static bool
+migrate (struct inode *inode)
+{
+  struct inode_disk *disk = &inode->data;
+  uint8_t *data;
+  bool success = true;
+
+  if (!is_inline (disk))
+    return true;
+
+  data = calloc (1, BLOCK_SECTOR_SIZE);
+  if (data == NULL)
+    return false;
+
+  journal_begin (ALLOCATE_SECTORS);
+  rwlock_acquire_write (&inode->lock);
+  cache_read (inode->sector, data, INLINE_OFS, INLINE_MAX);
+  memset (disk->extents, 0, sizeof disk->extents);
+  if (disk->length > 0)
+    {
+      /* The data sector is file data, so it is not logged, and
+         later writes to it need not be either.  Like any new
+         data, it goes home before the transaction that points
+         the inode to it commits. */
+      block_sector_t sector;
+
+      if (allocate (disk, 0, 1, &sector) == 1)
+        {
+          cache_write_data (sector, data, 0, BLOCK_SECTOR_SIZE);
+          write_inode (inode);
+        }
+      else
+        success = false;
+    }
+  rwlock_release_write (&inode->lock);
+  journal_end ();
+
+  free (data);
+  return success;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   POS, because POS is past end of file or in a hole. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
+  block_sector_t sector = -1;
+  struct extent e;
+  uint32_t file_sector;
+  size_t idx;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
+  if (pos >= inode->data.length)
     return -1;
+
+  file_sector = pos / BLOCK_SECTOR_SIZE;
+  rwlock_acquire_read (&inode->lock);
+  if (find_extent (&inode->data, file_sector, &idx, &e))
+    sector = e.start + (file_sector - e.ofs);
+  rwlock_release_read (&inode->lock);
+  return sector;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode'.  OPEN_INODES_LOCK
+   protects the table and every open inode's `open_cnt' and
+   `deny_write_cnt'. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("open inode table creation failed");
+  lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  The data is a hole, which reads as zeros, so no data
+   sectors are allocated until they are written.
    Returns true if successful.
-   Returns false if memory or disk allocation fails. */
+   Returns false if memory allocation fails. */
 bool
 inode_create (block_sector_t sector, off_t length)
 {
@@ -80,26 +570,15 @@ inode_create (block_sector_t sector, off_t length)
   /* If this assertion fails, the inode structure is not exactly
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct extent_block) == BLOCK_SECTOR_SIZE);
 
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
-        {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
+      cache_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+      success = true; 
       free (disk_inode);
     }
   return success;
@@ -111,33 +590,44 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
 
+  lock_acquire (&open_inodes_lock);
+
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+      return inode;
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  Read the inode before releasing the lock, so
+     that nobody else who opens it sees it half-initialized. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->read_pos = 0;
+  rwlock_init (&inode->lock);
+  lock_init (&inode->extend_lock);
+  lock_init (&inode->dir_lock);
+  cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  hash_insert (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +636,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -163,22 +657,26 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          release_sectors (&inode->data);
         }
 
       free (inode); 
@@ -196,13 +694,24 @@ inode_remove (struct inode *inode)
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
+   than SIZE if an error occurs or end of file is reached.
+   If the read continues where the previous one ended, the
+   sector after the data read is read ahead. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  uint8_t *bounce;
+  bool sequential = offset == inode->read_pos;
+  off_t next;
+
+  if (read_inline (inode, buffer, size, offset, &bytes_read))
+    return bytes_read;
+
+  bounce = malloc (BLOCK_SECTOR_SIZE);
+  if (bounce == NULL)
+    return 0;
 
   while (size > 0) 
     {
@@ -220,24 +729,13 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
+      if (sector_idx != (block_sector_t) -1)
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          cache_read (sector_idx, bounce, sector_ofs, chunk_size);
+          memcpy (buffer + bytes_read, bounce, chunk_size);
         }
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
@@ -245,15 +743,24 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       bytes_read += chunk_size;
     }
   free (bounce);
+  inode->read_pos = offset;
+
+  next = ROUND_UP (offset, BLOCK_SECTOR_SIZE);
+  if (sequential && bytes_read > 0 && next < inode_length (inode))
+    {
+      block_sector_t sector = byte_to_sector (inode, next);
+      if (sector != (block_sector_t) -1)
+        cache_readahead (sector);
+    }
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up.  A write past end of file
+   extends the inode, and any gap before OFFSET reads as
+   zeros. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
@@ -261,59 +768,102 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
   uint8_t *bounce = NULL;
+  bool extending;
 
-  if (inode->deny_write_cnt)
+  if (inode->deny_write_cnt || size <= 0)
     return 0;
 
+  extending = offset + size > inode->data.length;
+  if (extending)
+    lock_acquire (&inode->extend_lock);
+
+  if (write_inline (inode, buffer, size, offset))
+    {
+      bytes_written = size;
+      goto done;
+    }
+  if (extending && !migrate (inode))
+    goto done;
+  bounce = malloc (BLOCK_SECTOR_SIZE);
+  if (bounce == NULL)
+    goto done;
+
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      uint32_t file_sector = offset / BLOCK_SECTOR_SIZE;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+      block_sector_t sector_idx;
+      struct extent e;
+      size_t idx;
+      bool found;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Bytes left in sector. */
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
+      int chunk_size = size < sector_left ? size : sector_left;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
+      rwlock_acquire_read (&inode->lock);
+      found = find_extent (&inode->data, file_sector, &idx, &e);
+      rwlock_release_read (&inode->lock);
+
+      if (!found)
         {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
+          /* First write to a hole.  Allocate sectors for as much
+             of the rest of the write as we can, unless another
+             writer beat us to it. */
+          size_t want = bytes_to_sectors (offset + size) - file_sector;
+
+          if (want > ALLOCATE_MAX)
+            want = ALLOCATE_MAX;
+
+          journal_begin (ALLOCATE_SECTORS);
+          rwlock_acquire_write (&inode->lock);
+          found = find_extent (&inode->data, file_sector, &idx, &e);
+          if (!found)
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
+              block_sector_t start;
+              size_t cnt, i;
+
+              cnt = allocate (&inode->data, file_sector, want, &start);
+              for (i = 0; i < cnt; i++)
+                cache_zero (start + i);
+              write_inode (inode);
+              found = find_extent (&inode->data, file_sector, &idx, &e);
+              ASSERT (found == (cnt > 0));
             }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          rwlock_release_write (&inode->lock);
+          journal_end ();
+          if (!found)
+            break;
         }
+      sector_idx = e.start + (file_sector - e.ofs);
+
+      memcpy (bounce, buffer + bytes_written, chunk_size);
+      cache_write (sector_idx, bounce, sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
+  /* Extend the file if the write went past its end. */
+  if (bytes_written > 0 && offset > inode->data.length)
+    {
+      journal_begin (1);
+      rwlock_acquire_write (&inode->lock);
+      inode->data.length = offset;
+      write_inode (inode);
+      rwlock_release_write (&inode->lock);
+      journal_end ();
+    }
+
+ done:
+  free (bounce);
+  if (extending)
+    lock_release (&inode->extend_lock);
   return bytes_written;
 }
 
@@ -322,8 +872,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&open_inodes_lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&open_inodes_lock);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +884,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&open_inodes_lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&open_inodes_lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +897,36 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Locks INODE, which must be a directory's, against other
+   directory operations. */
+void
+inode_lock (struct inode *inode)
+{
+  lock_acquire (&inode->dir_lock);
+}
+
+/* Unlocks INODE, which inode_lock() locked. */
+void
+inode_unlock (struct inode *inode)
+{
+  lock_release (&inode->dir_lock);
+}
+
+/* Returns a hash value for the open inode that E refers to. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct inode *inode = hash_entry (e, struct inode, elem);
+  return hash_int (inode->sector);
+}
+
+/* Returns true if open inode A precedes open inode B. */
+static bool
+inode_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct inode *a = hash_entry (a_, struct inode, elem);
+  const struct inode *b = hash_entry (b_, struct inode, elem);
+  return a->sector < b->sector;
+}
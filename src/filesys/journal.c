@@ -0,0 +1,618 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Metadata journal.
+
+   Creating, removing, or growing a file changes several
+   metadata sectors: the free map, inodes, extent blocks, and
+   directories.  To make each such change atomic across crashes,
+   the file system brackets it with journal_begin() and
+   journal_end().  Every sector that the thread writes through
+   the buffer cache in between joins the running transaction and
+   is marked "logged" in the cache, which keeps the cache from
+   writing it to its home location.  Calls nest, so only the
+   outermost pair of calls in a thread counts.
+
+   The running transaction gathers the changes of every thread
+   until it is committed, which happens when the flush daemon
+   runs, when the transaction is getting full, or when the file
+   system is shut down.  A commit waits for every thread to reach
+   journal_end(), then writes the transaction's sectors to the
+   log one after another, followed by a descriptor that lists
+   their home sectors.  block_write() is synchronous, so the
+   descriptor reaches the disk only after the sectors, which
+   makes it the commit record.  The cache may then write the
+   sectors home whenever it likes.  Sectors of new file data are
+   not logged, but they are zeroed or written before metadata
+   points to them, so a commit first writes home everything in
+   the cache that is not logged.
+
+   The log takes JOURNAL_SECTORS sectors starting at
+   JOURNAL_SECTOR.  The first is a header that gives the sequence
+   number of the descriptor expected at the start of the log.
+   Each committed transaction follows the previous one, with the
+   next sequence number.  When too little room is left for
+   another transaction, a checkpoint writes every modified sector
+   in the cache home and empties the log by advancing the
+   header's sequence number.
+
+   Sectors released during a transaction stay allocated until it
+   commits, because until then a crash would bring back the
+   metadata that uses them.  Once freed, a sector that was logged
+   may be reused for file data, which is not journaled, and
+   replaying its old image would overwrite that data.  So each
+   descriptor also lists the logged sectors freed by its
+   transaction, and replay skips the images of a sector that a
+   later transaction freed.
+
+   At mount time, journal_open() replays every complete
+   transaction in the log, in order, and then empties the log.
+   Replay writes whole sectors, so replaying a transaction whose
+   sectors had already reached home does no harm.
+
+   A transaction holds at most JOURNAL_TXN_MAX sectors, because
+   logged sectors stay in the cache until they are committed.
+   Each caller of journal_begin() therefore reserves room for the
+   most sectors it expects to log, and waits for the running
+   transaction to commit if the transaction's sectors plus the
+   reservations of the threads in it would leave too little.
+   Only a change that logs more than it reserved, such as a
+   rehash of a large directory, can find the transaction full,
+   and its extra writes bypass the journal.  If an older image of
+   such a sector is in the log, the transaction revokes it as if
+   the sector had been freed, so that replay does not write the
+   image over the newer contents. */
+
+/* Identifies the journal header and descriptors. */
+#define HEADER_MAGIC 0x4c4e524a
+#define DESC_MAGIC 0x4353454a
+
+/* Maximum number of sectors in a transaction. */
+#define JOURNAL_TXN_MAX 32
+
+/* Number of sectors in a transaction that causes a commit. */
+#define JOURNAL_TXN_SOFT (JOURNAL_TXN_MAX * 3 / 4)
+
+/* Number of sectors in the log proper, after the header. */
+#define LOG_SECTORS (JOURNAL_SECTORS - 1)
+
+/* Number of sector numbers in a descriptor. */
+#define DESC_SLOTS ((BLOCK_SECTOR_SIZE - 4 * sizeof (uint32_t)) \
+                    / sizeof (block_sector_t))
+
+/* Journal header, in sector JOURNAL_SECTOR. */
+struct journal_header
+  {
+    uint32_t magic;                     /* HEADER_MAGIC. */
+    uint32_t seq;                       /* Sequence number of first
+                                           descriptor in the log. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 2 * sizeof (uint32_t)];
+  };
+
+/* Descriptor of a committed transaction.  Its SECTOR_CNT images
+   follow it in the log. */
+struct journal_desc
+  {
+    uint32_t magic;                     /* DESC_MAGIC. */
+    uint32_t seq;                       /* Sequence number. */
+    uint32_t sector_cnt;                /* Number of images. */
+    uint32_t revoke_cnt;                /* Number of freed sectors. */
+    block_sector_t sectors[DESC_SLOTS]; /* Home sectors of the images,
+                                           then the freed sectors. */
+  };
+
+static bool enabled;                    /* Is there a journal? */
+static struct lock journal_lock;        /* Protects everything below. */
+static struct condition journal_cond;   /* Signaled on state changes. */
+
+/* The running transaction. */
+static unsigned handle_cnt;             /* Threads inside journal_begin(). */
+static bool committing;                 /* Is a commit in progress? */
+static bool commit_wanted;              /* Commit as soon as possible? */
+static block_sector_t txn_sectors[JOURNAL_TXN_MAX]; /* Logged sectors. */
+static size_t txn_cnt;
+static size_t reserved;                 /* Sectors reserved, not logged. */
+static block_sector_t revokes[DESC_SLOTS]; /* Freed logged sectors. */
+static size_t revoke_cnt;
+static struct list releases;            /* Sectors to free on commit. */
+
+/* Sectors released by a transaction. */
+struct release
+  {
+    struct list_elem elem;              /* Element in `releases'. */
+    block_sector_t sector;              /* First sector. */
+    size_t cnt;                         /* Number of sectors. */
+  };
+
+/* The log. */
+static uint32_t next_seq;               /* Sequence number of next commit. */
+static size_t log_pos;                  /* Next free sector in the log. */
+static block_sector_t log_set[LOG_SECTORS]; /* Home sectors in the log. */
+static size_t log_set_cnt;
+
+/* Statistics. */
+static long long handles;               /* Outermost journal_begin() calls. */
+static long long commits;               /* Transactions committed. */
+static long long logged_sectors;        /* Sector images logged. */
+static long long checkpoints;           /* Times the log was emptied. */
+static long long overflows;             /* Writes that bypassed the log. */
+
+static void do_commit (void);
+static void write_header (void);
+static void replay (void);
+static bool contains (const block_sector_t[], size_t cnt, block_sector_t);
+
+/* Creates an empty journal, when formatting the file system. */
+void
+journal_create (void)
+{
+  static struct journal_desc zeros;
+
+  ASSERT (sizeof zeros == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_header) == BLOCK_SECTOR_SIZE);
+
+  next_seq = 1;
+  write_header ();
+  block_write (fs_device, JOURNAL_SECTOR + 1, &zeros);
+}
+
+/* Finds the journal, replays any transactions committed before a
+   crash, and starts journaling.  A file system without a journal
+   is mounted without one. */
+void
+journal_open (void)
+{
+  struct journal_header h;
+
+  lock_init (&journal_lock);
+  cond_init (&journal_cond);
+  list_init (&releases);
+
+  block_read (fs_device, JOURNAL_SECTOR, &h);
+  if (h.magic != HEADER_MAGIC)
+    {
+      printf ("journal: none found, metadata is not journaled\n");
+      return;
+    }
+
+  next_seq = h.seq;
+  replay ();
+  enabled = true;
+}
+
+/* Commits the running transaction, writes every modified sector
+   home, and empties the log. */
+void
+journal_close (void)
+{
+  journal_commit ();
+  cache_flush ();
+  if (enabled)
+    {
+      lock_acquire (&journal_lock);
+      write_header ();
+      log_pos = 0;
+      log_set_cnt = 0;
+      lock_release (&journal_lock);
+    }
+}
+
+/* Starts a change to the file system that must be atomic and
+   that logs at most SECTOR_CNT sectors.  Waits while a commit is
+   in progress or wanted, or until the running transaction has
+   room for SECTOR_CNT more sectors, unless the thread is already
+   inside journal_begin(), in which case the outermost call's
+   SECTOR_CNT must cover this change as well. */
+void
+journal_begin (size_t sector_cnt)
+{
+  struct thread *t = thread_current ();
+
+  if (!enabled || t->journal_depth++ > 0)
+    return;
+  if (sector_cnt > JOURNAL_TXN_MAX)
+    sector_cnt = JOURNAL_TXN_MAX;
+
+  lock_acquire (&journal_lock);
+  for (;;)
+    {
+      if (committing || commit_wanted)
+        cond_wait (&journal_cond, &journal_lock);
+      else if (txn_cnt + reserved + sector_cnt > JOURNAL_TXN_MAX)
+        {
+          /* Too full.  Commit as soon as the threads in the
+             transaction are done, or now if there are none. */
+          commit_wanted = true;
+          if (handle_cnt == 0)
+            do_commit ();
+        }
+      else
+        break;
+    }
+  reserved += sector_cnt;
+  t->journal_reserved = sector_cnt;
+  handle_cnt++;
+  handles++;
+  lock_release (&journal_lock);
+}
+
+/* Ends a change started with journal_begin().  The last thread
+   out of a transaction that wants to be committed commits it. */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  if (!enabled)
+    return;
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  reserved -= t->journal_reserved;
+  t->journal_reserved = 0;
+  if (--handle_cnt == 0)
+    {
+      if (commit_wanted)
+        do_commit ();
+      else
+        cond_broadcast (&journal_cond, &journal_lock);
+    }
+  lock_release (&journal_lock);
+}
+
+/* Adds SECTOR, which the running thread is writing in the buffer
+   cache, to the running transaction.  Returns true if the cache
+   must keep SECTOR from going home until the transaction
+   commits, false if the thread is not in a transaction or the
+   transaction is full.  Called with the cache entry's lock
+   held. */
+bool
+journal_add (block_sector_t sector)
+{
+  struct thread *t = thread_current ();
+  bool logged = false;
+  size_t i;
+
+  if (!enabled || t->journal_depth == 0)
+    return false;
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < revoke_cnt; i++)
+    if (revokes[i] == sector)
+      {
+        /* Reused after being freed. */
+        revokes[i] = revokes[--revoke_cnt];
+        break;
+      }
+  if (contains (txn_sectors, txn_cnt, sector))
+    logged = true;
+  else if (t->journal_reserved > 0 || txn_cnt + reserved < JOURNAL_TXN_MAX)
+    {
+      /* Use up the thread's reservation first, then room that
+         nobody reserved. */
+      if (t->journal_reserved > 0)
+        {
+          t->journal_reserved--;
+          reserved--;
+        }
+      ASSERT (txn_cnt < JOURNAL_TXN_MAX);
+      txn_sectors[txn_cnt++] = sector;
+      if (txn_cnt >= JOURNAL_TXN_SOFT)
+        commit_wanted = true;
+      logged = true;
+    }
+  else
+    {
+      /* SECTOR goes home without being logged, so make sure that
+         replay does not write an older image over it. */
+      if (contains (log_set, log_set_cnt, sector)
+          && !contains (revokes, revoke_cnt, sector))
+        {
+          ASSERT (revoke_cnt < DESC_SLOTS);
+          revokes[revoke_cnt++] = sector;
+        }
+      overflows++;
+    }
+  lock_release (&journal_lock);
+
+  return logged;
+}
+
+/* Takes charge of releasing CNT sectors starting at SECTOR,
+   which the running transaction no longer uses.  They are
+   returned to the free map when the transaction commits, and
+   replay will not write over them if they are reused.  Returns
+   false if there is no journal, in which case the caller must
+   free them itself. */
+bool
+journal_release (block_sector_t sector, size_t cnt)
+{
+  struct release *r;
+  size_t i;
+
+  if (!enabled)
+    return false;
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < log_set_cnt + txn_cnt; i++)
+    {
+      block_sector_t s = (i < log_set_cnt ? log_set[i]
+                          : txn_sectors[i - log_set_cnt]);
+      if (s >= sector && s - sector < cnt
+          && !contains (revokes, revoke_cnt, s))
+        {
+          ASSERT (revoke_cnt < DESC_SLOTS);
+          revokes[revoke_cnt++] = s;
+        }
+    }
+
+  /* If we are out of memory, the sectors are lost until the
+     file system is checked, which is better than corrupting
+     it. */
+  r = malloc (sizeof *r);
+  if (r != NULL)
+    {
+      r->sector = sector;
+      r->cnt = cnt;
+      list_push_back (&releases, &r->elem);
+    }
+  lock_release (&journal_lock);
+
+  return true;
+}
+
+/* Commits the running transaction, waiting for the threads in it
+   to reach journal_end(). */
+void
+journal_commit (void)
+{
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (thread_current ()->journal_depth == 0);
+  commit_wanted = true;
+  while (committing || handle_cnt > 0)
+    cond_wait (&journal_cond, &journal_lock);
+  if (commit_wanted)
+    do_commit ();
+  lock_release (&journal_lock);
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void)
+{
+  if (!enabled)
+    return;
+  printf ("Journal: %lld transactions in %lld commits, "
+          "%lld sectors logged, %lld checkpoints, %lld overflows\n",
+          handles, commits, logged_sectors, checkpoints, overflows);
+}
+
+/* Writes the running transaction to the log and lets the cache
+   write its sectors home.  Empties the log afterward if it is
+   too full for another transaction.  JOURNAL_LOCK must be held
+   and no thread may be in the transaction. */
+static void
+do_commit (void)
+{
+  struct journal_desc *d;
+  uint8_t *image;
+  block_sector_t base;
+  size_t commit_revokes;
+  struct list freeing;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (handle_cnt == 0 && !committing);
+
+  commit_wanted = false;
+  if (txn_cnt == 0 && revoke_cnt == 0 && list_empty (&releases))
+    {
+      cond_broadcast (&journal_cond, &journal_lock);
+      return;
+    }
+
+  /* Nobody can join the transaction until we are done, so we can
+     do the I/O without the lock.  Sectors freed meanwhile go in
+     the next transaction. */
+  committing = true;
+  commit_revokes = revoke_cnt;
+  list_init (&freeing);
+  while (!list_empty (&releases))
+    list_push_back (&freeing, list_pop_front (&releases));
+  lock_release (&journal_lock);
+
+  d = calloc (1, sizeof *d);
+  image = malloc (BLOCK_SECTOR_SIZE);
+  if (d == NULL || image == NULL)
+    PANIC ("journal: out of memory");
+  d->magic = DESC_MAGIC;
+  d->seq = next_seq;
+
+  /* Sectors zeroed for new file data are not logged, but the
+     transaction's metadata may point to them, so write them
+     home first.  Writing everything that is not logged is
+     simplest. */
+  cache_flush ();
+
+  /* Write the images, skipping sectors freed since they were
+     logged. */
+  base = JOURNAL_SECTOR + 1 + log_pos;
+  for (i = 0; i < txn_cnt; i++)
+    if (!contains (revokes, commit_revokes, txn_sectors[i]))
+      {
+        cache_read (txn_sectors[i], image, 0, BLOCK_SECTOR_SIZE);
+        block_write (fs_device, base + 1 + d->sector_cnt, image);
+        d->sectors[d->sector_cnt++] = txn_sectors[i];
+      }
+  memcpy (d->sectors + d->sector_cnt, revokes,
+          commit_revokes * sizeof *revokes);
+  d->revoke_cnt = commit_revokes;
+
+  /* Commit. */
+  block_write (fs_device, base, d);
+  for (i = 0; i < txn_cnt; i++)
+    cache_unlog (txn_sectors[i]);
+  while (!list_empty (&freeing))
+    {
+      struct release *r = list_entry (list_pop_front (&freeing),
+                                      struct release, elem);
+      free_map_free (r->sector, r->cnt);
+      free (r);
+    }
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < d->sector_cnt; i++)
+    if (!contains (log_set, log_set_cnt, d->sectors[i]))
+      log_set[log_set_cnt++] = d->sectors[i];
+  log_pos += 1 + d->sector_cnt;
+  next_seq++;
+  commits++;
+  logged_sectors += d->sector_cnt;
+  txn_cnt = 0;
+  revoke_cnt -= commit_revokes;
+  memmove (revokes, revokes + commit_revokes, revoke_cnt * sizeof *revokes);
+  free (image);
+  free (d);
+
+  /* Make sure that the next transaction will fit.  No sector is
+     logged now, so the cache can write everything home, after
+     which the log and the sectors freed since are of no more
+     use. */
+  if (log_pos + 1 + JOURNAL_TXN_MAX > LOG_SECTORS)
+    {
+      lock_release (&journal_lock);
+      cache_flush ();
+      lock_acquire (&journal_lock);
+      write_header ();
+      log_pos = 0;
+      log_set_cnt = 0;
+      revoke_cnt = 0;
+      checkpoints++;
+    }
+
+  committing = false;
+  cond_broadcast (&journal_cond, &journal_lock);
+}
+
+/* Writes the journal header, which starts the log at NEXT_SEQ.
+   Invalidates every transaction in the log. */
+static void
+write_header (void)
+{
+  static struct journal_header h;
+
+  h.magic = HEADER_MAGIC;
+  h.seq = next_seq;
+  block_write (fs_device, JOURNAL_SECTOR, &h);
+}
+
+/* A sector freed by a committed transaction. */
+struct revoke
+  {
+    block_sector_t sector;              /* Freed sector. */
+    uint32_t seq;                       /* Transaction that freed it. */
+  };
+
+/* Replays the committed transactions in the log, then empties
+   it. */
+static void
+replay (void)
+{
+  struct journal_desc *d;
+  struct revoke *revoked = NULL;
+  size_t revoked_cnt = 0;
+  uint8_t *image;
+  uint32_t seq;
+  size_t pos, i, j;
+  int pass;
+
+  d = malloc (sizeof *d);
+  image = malloc (BLOCK_SECTOR_SIZE);
+  if (d == NULL || image == NULL)
+    PANIC ("journal: out of memory");
+
+  /* The first pass finds the freed sectors, the second writes
+     the images that are still wanted. */
+  for (pass = 0; pass < 2; pass++)
+    {
+      seq = next_seq;
+      for (pos = 0; pos < LOG_SECTORS; pos += 1 + d->sector_cnt)
+        {
+          block_read (fs_device, JOURNAL_SECTOR + 1 + pos, d);
+          if (d->magic != DESC_MAGIC || d->seq != seq
+              || d->sector_cnt + d->revoke_cnt > DESC_SLOTS
+              || pos + 1 + d->sector_cnt > LOG_SECTORS)
+            break;
+
+          if (pass == 0)
+            {
+              struct revoke *r;
+
+              r = realloc (revoked, (revoked_cnt + d->revoke_cnt)
+                                    * sizeof *revoked);
+              if (r == NULL && d->revoke_cnt > 0)
+                PANIC ("journal: out of memory");
+              revoked = r;
+              for (i = 0; i < d->revoke_cnt; i++)
+                {
+                  revoked[revoked_cnt].sector = d->sectors[d->sector_cnt + i];
+                  revoked[revoked_cnt++].seq = seq;
+                }
+            }
+          else
+            for (i = 0; i < d->sector_cnt; i++)
+              {
+                for (j = 0; j < revoked_cnt; j++)
+                  if (revoked[j].sector == d->sectors[i]
+                      && revoked[j].seq >= seq)
+                    break;
+                if (j < revoked_cnt)
+                  continue;
+
+                block_read (fs_device, JOURNAL_SECTOR + 2 + pos + i, image);
+                cache_write (d->sectors[i], image, 0, BLOCK_SECTOR_SIZE);
+              }
+          seq++;
+        }
+    }
+
+  if (seq != next_seq)
+    {
+      printf ("journal: replayed %"PRIu32" transactions\n", seq - next_seq);
+      cache_flush ();
+      next_seq = seq;
+      write_header ();
+    }
+
+  free (revoked);
+  free (image);
+  free (d);
+}
+
+/* Returns true if SECTOR is among the CNT sectors in ARRAY. */
+static bool
+contains (const block_sector_t array[], size_t cnt, block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (array[i] == sector)
+      return true;
+  return false;
+}
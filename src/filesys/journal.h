@@ -0,0 +1,23 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Number of sectors in the journal, starting at JOURNAL_SECTOR. */
+#define JOURNAL_SECTORS 64
+
+void journal_create (void);
+void journal_open (void);
+void journal_close (void);
+
+void journal_begin (size_t sector_cnt);
+void journal_end (void);
+bool journal_add (block_sector_t);
+bool journal_release (block_sector_t, size_t cnt);
+void journal_commit (void);
+
+void journal_print_stats (void);
+
+#endif /* filesys/journal.h */
@@ -358,6 +358,25 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes SIZE bytes of B, starting at byte offset OFS, to the
+   same place in FILE, so that FILE is updated as if by
+   bitmap_write() but only in that range.  The range is
+   truncated at the end of B.  Returns true if successful, false
+   otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   size_t ofs, size_t size)
+{
+  size_t total = byte_cnt (b->bit_cnt);
+
+  if (ofs >= total)
+    return true;
+  if (size > total - ofs)
+    size = total - ofs;
+  return file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs)
+         == (off_t) size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
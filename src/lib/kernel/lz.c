@@ -0,0 +1,221 @@
+#include "lz.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Compressed data is a series of sequences, each of which is a
+   run of literal bytes followed by a match, a copy of earlier
+   output.  A sequence is encoded as:
+
+        - A token byte.  Its high 4 bits are the number of
+          literals and its low 4 bits are the match length minus
+          MIN_MATCH.  A field of 15 means that more length bytes
+          follow: each adds its value to the field, and the last
+          one is less than 255.  The literal length bytes come
+          right after the token, the match length bytes after the
+          offset.
+
+        - The literals.
+
+        - The match offset, the distance back from the current
+          output position, in 2 bytes, least significant first.
+
+   The last sequence has literals only.  It ends the data. */
+
+/* Shortest match that is worth encoding. */
+#define MIN_MATCH 4
+
+/* Longest match offset. */
+#define MAX_OFFSET 65535
+
+/* Reads 4 bytes at P, which need not be aligned. */
+static uint32_t
+read32 (const uint8_t *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof v);
+  return v;
+}
+
+/* Returns the hash table index for the 4 bytes V. */
+static size_t
+hash4 (uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - LZ_TABLE_BITS);
+}
+
+/* Writes the extra length bytes for a length field whose value
+   is LEN more than 15 at OP, which must be before END.  Returns
+   the position after them, or a null pointer if they do not
+   fit. */
+static uint8_t *
+put_length (uint8_t *op, uint8_t *end, size_t len)
+{
+  for (;;)
+    {
+      if (op >= end)
+        return NULL;
+      if (len < 255)
+        {
+          *op++ = len;
+          return op;
+        }
+      *op++ = 255;
+      len -= 255;
+    }
+}
+
+/* Writes a sequence at OP, which must be before END, with the
+   LIT_CNT literals at LIT followed by a match of MATCH_LEN bytes
+   at OFFSET, or no match if MATCH_LEN is 0.  Returns the
+   position after the sequence, or a null pointer if it does not
+   fit. */
+static uint8_t *
+put_sequence (uint8_t *op, uint8_t *end, const uint8_t *lit,
+              size_t lit_cnt, size_t offset, size_t match_len)
+{
+  uint8_t *token;
+  size_t extra;
+
+  if (op >= end)
+    return NULL;
+  token = op++;
+  *token = (lit_cnt < 15 ? lit_cnt : 15) << 4;
+  if (lit_cnt >= 15 && (op = put_length (op, end, lit_cnt - 15)) == NULL)
+    return NULL;
+  if ((size_t) (end - op) < lit_cnt)
+    return NULL;
+  memcpy (op, lit, lit_cnt);
+  op += lit_cnt;
+  if (match_len == 0)
+    return op;
+
+  if (end - op < 2)
+    return NULL;
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+  extra = match_len - MIN_MATCH;
+  *token |= extra < 15 ? extra : 15;
+  if (extra >= 15)
+    op = put_length (op, end, extra - 15);
+  return op;
+}
+
+/* Compresses the SRC_SIZE bytes at SRC into the DST_SIZE bytes
+   at DST, using TABLE as scratch space.  SRC_SIZE must not
+   exceed LZ_MAX_INPUT.  Returns the number of bytes of DST
+   used, or 0 if the compressed data would not fit. */
+size_t
+lz_compress (const void *src_, size_t src_size, void *dst_, size_t dst_size,
+             uint16_t table[LZ_TABLE_SIZE])
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *end = dst + dst_size;
+  size_t ip = 0;
+  size_t anchor = 0;
+
+  ASSERT (src_size <= LZ_MAX_INPUT);
+
+  /* Stale entries would only cost us matches, because every
+     candidate is checked, but start afresh so that the output
+     depends on the input alone. */
+  memset (table, 0, sizeof *table * LZ_TABLE_SIZE);
+
+  while (ip + MIN_MATCH <= src_size)
+    {
+      uint32_t v = read32 (src + ip);
+      size_t h = hash4 (v);
+      size_t ref = table[h];
+
+      table[h] = ip;
+      if (ref < ip && ip - ref <= MAX_OFFSET && read32 (src + ref) == v)
+        {
+          size_t len = MIN_MATCH;
+
+          while (ip + len < src_size && src[ref + len] == src[ip + len])
+            len++;
+          op = put_sequence (op, end, src + anchor, ip - anchor,
+                             ip - ref, len);
+          if (op == NULL)
+            return 0;
+          ip += len;
+          anchor = ip;
+        }
+      else
+        ip++;
+    }
+
+  op = put_sequence (op, end, src + anchor, src_size - anchor, 0, 0);
+  return op != NULL ? (size_t) (op - dst) : 0;
+}
+
+/* Reads the extra length bytes of a length field at *IP, which
+   must be before END, adding them to *LEN and advancing *IP past
+   them.  Returns true if successful, false if the data is
+   truncated. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *end, size_t *len)
+{
+  uint8_t b;
+
+  do
+    {
+      if (*ip >= end)
+        return false;
+      b = *(*ip)++;
+      *len += b;
+    }
+  while (b == 255);
+  return true;
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC, produced by
+   lz_compress(), into the DST_SIZE bytes at DST.  Returns the
+   number of bytes of DST written, or 0 if the data is corrupt
+   or would not fit. */
+size_t
+lz_decompress (const void *src_, size_t src_size, void *dst_, size_t dst_size)
+{
+  const uint8_t *ip = src_;
+  const uint8_t *ip_end = ip + src_size;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *op_end = dst + dst_size;
+
+  while (ip < ip_end)
+    {
+      uint8_t token = *ip++;
+      size_t lit_cnt = token >> 4;
+      size_t match_len = (token & 15) + MIN_MATCH;
+      size_t offset;
+      const uint8_t *match;
+
+      /* Literals. */
+      if (lit_cnt == 15 && !get_length (&ip, ip_end, &lit_cnt))
+        return 0;
+      if (lit_cnt > (size_t) (ip_end - ip) || lit_cnt > (size_t) (op_end - op))
+        return 0;
+      memcpy (op, ip, lit_cnt);
+      ip += lit_cnt;
+      op += lit_cnt;
+      if (ip == ip_end)
+        break;
+
+      /* Match.  It may overlap the output it produces, so copy a
+         byte at a time. */
+      if (ip_end - ip < 2)
+        return 0;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (match_len == 15 + MIN_MATCH && !get_length (&ip, ip_end, &match_len))
+        return 0;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || match_len > (size_t) (op_end - op))
+        return 0;
+      for (match = op - offset; match_len > 0; match_len--)
+        *op++ = *match++;
+    }
+  return op - dst;
+}
@@ -0,0 +1,27 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fast LZ77-family compression, in the style of LZ4.
+
+   Compression finds matches through a small hash table of
+   recent positions that the caller supplies, so that the
+   compressor needs no memory of its own and no large stack
+   frame.  Inputs may be at most LZ_MAX_INPUT bytes long. */
+
+/* Number of entries in the hash table passed to lz_compress(). */
+#define LZ_TABLE_BITS 10
+#define LZ_TABLE_SIZE (1 << LZ_TABLE_BITS)
+
+/* Maximum length of the input to lz_compress(). */
+#define LZ_MAX_INPUT 65535
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size,
+                    uint16_t table[LZ_TABLE_SIZE]);
+size_t lz_decompress (const void *src, size_t src_size,
+                      void *dst, size_t dst_size);
+
+#endif /* lib/kernel/lz.h */
@@ -182,3 +182,21 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
+bool
+memstat (struct memstat *stat)
+{
+  return syscall1 (SYS_MEMSTAT, stat);
+}
+
+bool
+memlimit (size_t soft_limit, size_t hard_limit)
+{
+  return syscall2 (SYS_MEMLIMIT, soft_limit, hard_limit);
+}
@@ -2,6 +2,7 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <debug.h>
 
 /* Process identifier. */
@@ -15,6 +16,17 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* Memory use of a process, reported by memstat().  Sizes are in
+   pages; a limit of 0 means no limit. */
+struct memstat
+  {
+    size_t rss;                 /* Pages resident in memory. */
+    size_t wss;                 /* Estimated working set. */
+    unsigned long fault_cnt;    /* Page faults taken. */
+    size_t soft_limit;          /* Resident set soft limit. */
+    size_t hard_limit;          /* Resident set hard limit. */
+  };
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -45,4 +57,9 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+bool memstat (struct memstat *);
+bool memlimit (size_t soft_limit, size_t hard_limit);
+
 #endif /* lib/user/syscall.h */
@@ -19,6 +19,7 @@
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/memtrack.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
@@ -37,6 +38,11 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -57,7 +63,16 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* CPUID feature flags, in EDX for CPUID function 1. */
+#define CPUID_PSE (1 << 3)      /* Page size extension (4 MB pages). */
+#define CPUID_PGE (1 << 13)     /* Page global enable. */
+
+/* CR4 bits. */
+#define CR4_PSE 0x10            /* Page size extension. */
+#define CR4_PGE 0x80            /* Page global enable. */
+
 static void bss_init (void);
+static uint32_t cpuid_features (void);
 static void paging_init (void);
 
 static char **read_command_line (void);
@@ -96,6 +111,7 @@ main (void)
 
   /* Initialize memory system. */
   palloc_init (user_page_limit);
+  memtrack_init ();
   malloc_init ();
   paging_init ();
 
@@ -127,6 +143,12 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  swap_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -150,6 +172,17 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns the processor's feature flags from CPUID function 1.
+   See [IA32-v2a] "CPUID--CPU Identification". */
+static uint32_t
+cpuid_features (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return edx;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
@@ -160,6 +193,10 @@ paging_init (void)
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = cpuid_features ();
+  bool pse = (features & CPUID_PSE) != 0;
+  uint32_t global = (features & CPUID_PGE) != 0 ? PTE_G : 0;
+  size_t large_cnt = 0;
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -171,21 +208,52 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      /* Map each whole 4 MB of RAM with a single large page,
+         which takes one TLB entry instead of 1,024, unless it
+         contains kernel text, which must stay read-only. */
+      if (pse && pte_idx == 0
+          && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true) | global;
+          page += PTSPAN / PGSIZE - 1;
+          large_cnt++;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
+  /* Large pages must be enabled before we load a page directory
+     that uses them.  See [IA32-v3a] 3.7.3 "Mixing 4-KByte and
+     4-MByte Pages". */
+  if (pse)
+    asm volatile ("movl %%cr4, %%eax; orl %0, %%eax; movl %%eax, %%cr4"
+                  : : "i" (CR4_PSE) : "eax");
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  /* Kernel mappings are the same in every page directory, so
+     mark them global: loading CR3 on a process switch then
+     leaves their TLB entries alone.  See [IA32-v3a] 3.12
+     "Translation Lookaside Buffers". */
+  if (global)
+    asm volatile ("movl %%cr4, %%eax; orl %0, %%eax; movl %%eax, %%cr4"
+                  : : "i" (CR4_PGE) : "eax");
+
+  printf ("Kernel memory mapped with %zu 4 MB pages, %s.\n",
+          large_cnt, global ? "global" : "not global");
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -259,6 +327,18 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_limit = (size_t) atoi (value) * 1024;
+      else if (!strcmp (name, "-fa"))
+        fault_around_pages = atoi (value);
+      else if (!strcmp (name, "-rsl"))
+        rss_soft_limit_default = atoi (value);
+      else if (!strcmp (name, "-rsh"))
+        rss_hard_limit_default = atoi (value);
+      else if (!strcmp (name, "-zs"))
+        swap_pool_limit = (size_t) atoi (value) * 1024;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -292,6 +372,15 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+#ifdef MEMTRACK
+/* Prints the top memory-consuming allocation sites. */
+static void
+run_memtrack (char **argv UNUSED)
+{
+  memtrack_dump ();
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -309,6 +398,9 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+#ifdef MEMTRACK
+      {"memtrack", 1, run_memtrack},
+#endif
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -357,6 +449,9 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+#ifdef MEMTRACK
+          "  memtrack           Print top allocation sites and leaks.\n"
+#endif
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
@@ -381,6 +476,14 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=KB             Limit each user stack to KB kB.\n"
+          "  -fa=PAGES          Map up to PAGES file pages per page fault.\n"
+          "  -rsl=PAGES         Reclaim first from processes with more than\n"
+          "                     PAGES pages resident.\n"
+          "  -rsh=PAGES         Limit each process to PAGES resident pages.\n"
+          "  -zs=KB             Keep up to KB kB of compressed swap in memory.\n"
 #endif
           );
   shutdown_power_off ();
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/memtrack.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -28,16 +29,32 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Blocks bigger than 1 kB don't fit well into a single page
+   with a descriptor, so "medium" sizes (1.5 kB, 3 kB, and 6 kB)
+   get descriptors whose arenas span several contiguous pages.
+   Because a medium block need not lie in the first page of its
+   arena, each one is preceded by a MEDIUM_ALIGN-byte header that
+   points back to its arena.  Medium blocks are MEDIUM_ALIGN-byte
+   aligned, whereas every other block sits at an offset of
+   sizeof (struct arena) modulo MEDIUM_ALIGN within its page,
+   which is how block_to_arena() tells them apart.
+
+   We handle blocks bigger than the largest medium size by
+   allocating contiguous pages with the page allocator and
+   sticking the allocation size at the beginning of the
+   allocated block's arena header.
+
+   realloc() resizes a block in place when it still fits in the
+   block's descriptor size, or, for big blocks, when the pages
+   just past the block are free and can be appended to it. */
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
+    size_t slot_size;           /* Block size plus per-block header. */
+    size_t block_ofs;           /* Offset of first block in arena. */
+    size_t arena_pages;         /* Number of pages in an arena. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
@@ -54,6 +71,12 @@ struct arena
     size_t free_cnt;            /* Free blocks; pages in big block. */
   };
 
+/* Alignment of, and size of the header before, medium blocks. */
+#define MEDIUM_ALIGN 16
+
+/* Maximum number of pages in a medium arena. */
+#define MEDIUM_ARENA_PAGES 8
+
 /* Free block. */
 struct block 
   {
@@ -66,6 +89,8 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct desc *new_desc (size_t block_size);
+static bool resize_in_place (void *, size_t);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -73,15 +98,57 @@ malloc_init (void)
 {
   size_t block_size;
 
+  /* Medium blocks are told apart by their alignment. */
+  ASSERT (sizeof (struct arena) % MEDIUM_ALIGN != 0);
+
   for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
     {
-      struct desc *d = &descs[desc_cnt++];
-      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-      d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-      list_init (&d->free_list);
-      lock_init (&d->lock);
+      struct desc *d = new_desc (block_size);
+      d->slot_size = block_size;
+      d->block_ofs = sizeof (struct arena);
+      d->arena_pages = 1;
+      d->blocks_per_arena = (PGSIZE - d->block_ofs) / block_size;
     }
+
+  for (block_size = 1536; block_size <= 6144; block_size *= 2)
+    {
+      struct desc *d = new_desc (block_size);
+      size_t best_waste = SIZE_MAX;
+      size_t page_cnt;
+
+      d->slot_size = block_size + MEDIUM_ALIGN;
+      d->block_ofs = ROUND_UP (sizeof (struct arena), MEDIUM_ALIGN)
+                     + MEDIUM_ALIGN;
+
+      /* Pick the arena size that wastes the smallest fraction of
+         its pages, preferring smaller arenas on ties. */
+      for (page_cnt = 1; page_cnt <= MEDIUM_ARENA_PAGES; page_cnt++)
+        {
+          size_t usable = page_cnt * PGSIZE - (d->block_ofs - MEDIUM_ALIGN);
+          size_t blocks = usable / d->slot_size;
+          size_t waste = (usable - blocks * d->slot_size) * MEDIUM_ARENA_PAGES
+                         / page_cnt;
+          if (blocks > 0 && waste < best_waste)
+            {
+              best_waste = waste;
+              d->arena_pages = page_cnt;
+              d->blocks_per_arena = blocks;
+            }
+        }
+    }
+}
+
+/* Adds and returns a new descriptor for BLOCK_SIZE-byte blocks.
+   The caller must fill in its arena layout. */
+static struct desc *
+new_desc (size_t block_size) 
+{
+  struct desc *d = &descs[desc_cnt++];
+  ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+  d->block_size = block_size;
+  list_init (&d->free_list);
+  lock_init (&d->lock);
+  return d;
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -116,6 +183,7 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      memtrack_alloc (MEMTRACK_MALLOC, a + 1, size, MEMTRACK_CALLER ());
       return a + 1;
     }
 
@@ -126,8 +194,8 @@ malloc (size_t size)
     {
       size_t i;
 
-      /* Allocate a page. */
-      a = palloc_get_page (0);
+      /* Allocate the arena's pages. */
+      a = palloc_get_multiple (0, d->arena_pages);
       if (a == NULL) 
         {
           lock_release (&d->lock);
@@ -141,6 +209,8 @@ malloc (size_t size)
       for (i = 0; i < d->blocks_per_arena; i++) 
         {
           struct block *b = arena_to_block (a, i);
+          if (d->slot_size != d->block_size)
+            ((struct arena **) b)[-1] = a;
           list_push_back (&d->free_list, &b->free_elem);
         }
     }
@@ -150,6 +220,7 @@ malloc (size_t size)
   a = block_to_arena (b);
   a->free_cnt--;
   lock_release (&d->lock);
+  memtrack_alloc (MEMTRACK_MALLOC, b, size, MEMTRACK_CALLER ());
   return b;
 }
 
@@ -170,6 +241,7 @@ calloc (size_t a, size_t b)
   p = malloc (size);
   if (p != NULL)
     memset (p, 0, size);
+  memtrack_alloc (MEMTRACK_MALLOC, p, size, MEMTRACK_CALLER ());
 
   return p;
 }
@@ -199,9 +271,16 @@ realloc (void *old_block, size_t new_size)
       free (old_block);
       return NULL;
     }
+  else if (old_block != NULL && resize_in_place (old_block, new_size))
+    {
+      memtrack_resize (old_block, new_size);
+      return old_block;
+    }
   else 
     {
       void *new_block = malloc (new_size);
+      memtrack_alloc (MEMTRACK_MALLOC, new_block, new_size,
+                      MEMTRACK_CALLER ());
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -213,6 +292,27 @@ realloc (void *old_block, size_t new_size)
     }
 }
 
+/* Tries to make BLOCK hold NEW_SIZE bytes without moving it.
+   Returns true if successful, false otherwise. */
+static bool
+resize_in_place (void *block, size_t new_size) 
+{
+  struct arena *a = block_to_arena (block);
+  size_t page_cnt;
+
+  if (new_size <= block_size (block))
+    return true;
+  else if (a->desc != NULL)
+    return false;
+
+  /* A big block can grow if the pages after it are free. */
+  page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+  if (!palloc_extend_multiple (0, a, a->free_cnt, page_cnt))
+    return false;
+  a->free_cnt = page_cnt;
+  return true;
+}
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
@@ -223,7 +323,8 @@ free (void *p)
       struct block *b = p;
       struct arena *a = block_to_arena (b);
       struct desc *d = a->desc;
-      
+
+      memtrack_free (p);
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
@@ -249,7 +350,7 @@ free (void *p)
                   struct block *b = arena_to_block (a, i);
                   list_remove (&b->free_elem);
                 }
-              palloc_free_page (a);
+              palloc_free_multiple (a, d->arena_pages);
             }
 
           lock_release (&d->lock);
@@ -267,7 +368,21 @@ free (void *p)
 static struct arena *
 block_to_arena (struct block *b)
 {
-  struct arena *a = pg_round_down (b);
+  struct arena *a;
+
+  if ((uintptr_t) b % MEDIUM_ALIGN == 0)
+    {
+      /* Medium block: its header points to the arena. */
+      a = ((struct arena **) b)[-1];
+      ASSERT (a != NULL);
+      ASSERT (a->magic == ARENA_MAGIC);
+      ASSERT (a->desc != NULL && a->desc->slot_size != a->desc->block_size);
+      ASSERT (((uint8_t *) b - (uint8_t *) a - a->desc->block_ofs)
+              % a->desc->slot_size == 0);
+      return a;
+    }
+
+  a = pg_round_down (b);
 
   /* Check that the arena is valid. */
   ASSERT (a != NULL);
@@ -289,6 +404,6 @@ arena_to_block (struct arena *a, size_t idx)
   ASSERT (a->magic == ARENA_MAGIC);
   ASSERT (idx < a->desc->blocks_per_arena);
   return (struct block *) ((uint8_t *) a
-                           + sizeof *a
-                           + idx * a->desc->block_size);
+                           + a->desc->block_ofs
+                           + idx * a->desc->slot_size);
 }
@@ -0,0 +1,324 @@
+#include "threads/memtrack.h"
+#ifdef MEMTRACK
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Allocation-site accounting.
+
+   Every live allocation is recorded in an open-addressed hash
+   table keyed by its address, along with its size and the call
+   site that made it.  Call sites are identified by the return
+   address of the malloc() or palloc_get_*() call and live in a
+   second, fixed-size table that accumulates live bytes, live
+   allocation counts, and total allocation counts.
+
+   Each memtrack_dump() samples every site's live count.  A site
+   whose live count grew at each of the last MEMTRACK_HISTORY
+   samples is reported as a suspected leak.
+
+   The tables are shared by every thread and are touched from
+   palloc_free_page() while interrupts are off during thread
+   switches, so they are protected by disabling interrupts
+   rather than by a lock. */
+
+/* Number of call sites that can be tracked. */
+#define MEMTRACK_SITES 256
+
+/* Number of pages holding the live allocation table. */
+#define MEMTRACK_LIVE_PAGES 16
+
+/* Number of live-count samples kept for leak detection. */
+#define MEMTRACK_HISTORY 4
+
+/* Number of sites printed by memtrack_dump(). */
+#define MEMTRACK_TOP 10
+
+/* An allocation call site. */
+struct site
+  {
+    const void *caller;         /* Return address of the call. */
+    enum memtrack_kind kind;    /* Kind of allocation. */
+    size_t live_bytes;          /* Bytes currently allocated. */
+    size_t live_cnt;            /* Allocations currently live. */
+    uint64_t alloc_cnt;         /* Allocations ever made. */
+    uint64_t dump_alloc_cnt;    /* ALLOC_CNT at last dump. */
+    size_t history[MEMTRACK_HISTORY]; /* Sampled LIVE_CNTs, oldest first. */
+    size_t history_cnt;         /* Number of valid samples. */
+  };
+
+/* A live allocation. */
+struct live
+  {
+    const void *p;              /* Allocated address, null if unused. */
+    size_t size;                /* Size in bytes. */
+    struct site *site;          /* Allocating call site. */
+  };
+
+static struct site sites[MEMTRACK_SITES];
+static struct live *live;       /* Live allocation table. */
+static size_t live_cap;         /* Number of slots in LIVE. */
+static size_t live_used;        /* Number of slots in use. */
+static unsigned long dropped_cnt; /* Allocations we failed to record. */
+static int64_t dump_ticks;      /* Timer ticks at last dump. */
+
+static struct site *find_site (const void *caller, enum memtrack_kind);
+static struct live *find_live (const void *);
+static void remove_live (struct live *);
+
+/* Allocates the live allocation table.  Allocations made before
+   this point are not tracked. */
+void
+memtrack_init (void)
+{
+  live = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, MEMTRACK_LIVE_PAGES);
+  live_cap = MEMTRACK_LIVE_PAGES * PGSIZE / sizeof *live;
+  printf ("memtrack: tracking up to %zu live allocations.\n", live_cap);
+}
+
+/* Records that CALLER allocated SIZE bytes at P.  If P is
+   already recorded, the record is moved to CALLER. */
+void
+memtrack_alloc (enum memtrack_kind kind, const void *p, size_t size,
+                const void *caller)
+{
+  enum intr_level old_level;
+  struct site *s;
+  struct live *l;
+
+  if (live == NULL || p == NULL)
+    return;
+
+  old_level = intr_disable ();
+  s = find_site (caller, kind);
+  l = find_live (p);
+  if (l->p != NULL)
+    {
+      /* Already recorded by the function that our caller is
+         built on, e.g. malloc() for calloc().  Move it. */
+      l->site->live_bytes -= l->size;
+      l->site->live_cnt--;
+      l->site->alloc_cnt--;
+      remove_live (l);
+      l = find_live (p);
+    }
+
+  /* Always leave one slot empty so that probes terminate. */
+  if (s == NULL || live_used + 1 >= live_cap)
+    dropped_cnt++;
+  else
+    {
+      l->p = p;
+      l->size = size;
+      l->site = s;
+      live_used++;
+
+      s->live_bytes += size;
+      s->live_cnt++;
+      s->alloc_cnt++;
+    }
+  intr_set_level (old_level);
+}
+
+/* Records that the allocation at P now has SIZE bytes. */
+void
+memtrack_resize (const void *p, size_t size)
+{
+  enum intr_level old_level;
+  struct live *l;
+
+  if (live == NULL || p == NULL)
+    return;
+
+  old_level = intr_disable ();
+  l = find_live (p);
+  if (l != NULL && l->p != NULL)
+    {
+      l->site->live_bytes += size - l->size;
+      l->size = size;
+    }
+  intr_set_level (old_level);
+}
+
+/* Records that the allocation at P was freed. */
+void
+memtrack_free (const void *p)
+{
+  enum intr_level old_level;
+  struct live *l;
+
+  if (live == NULL || p == NULL)
+    return;
+
+  old_level = intr_disable ();
+  l = find_live (p);
+  if (l != NULL && l->p != NULL)
+    {
+      l->site->live_bytes -= l->size;
+      l->site->live_cnt--;
+      remove_live (l);
+    }
+  intr_set_level (old_level);
+}
+
+/* Orders sites by decreasing live bytes. */
+static int
+compare_live_bytes (const void *a_, const void *b_)
+{
+  const struct site *a = a_;
+  const struct site *b = b_;
+
+  return a->live_bytes < b->live_bytes ? 1 : a->live_bytes > b->live_bytes;
+}
+
+/* Returns true if S's live count grew at every sample. */
+static bool
+is_suspected_leak (const struct site *s)
+{
+  size_t i;
+
+  if (s->history_cnt < MEMTRACK_HISTORY)
+    return false;
+  for (i = 1; i < MEMTRACK_HISTORY; i++)
+    if (s->history[i] <= s->history[i - 1])
+      return false;
+  return true;
+}
+
+/* Prints the call sites with the most live memory, each with its
+   allocation rate since the previous dump, followed by the
+   suspected leaks.  Caller addresses can be translated with the
+   `backtrace' utility. */
+void
+memtrack_dump (void)
+{
+  static struct site top[MEMTRACK_TOP], leaks[MEMTRACK_TOP];
+  size_t top_cnt = 0, leak_cnt = 0;
+  size_t total_bytes = 0;
+  int64_t now = timer_ticks ();
+  int64_t elapsed = now - dump_ticks;
+  enum intr_level old_level;
+  size_t i;
+
+  if (elapsed <= 0)
+    elapsed = 1;
+
+  /* Sample every site, then snapshot the most interesting ones
+     so that we can print them with interrupts on. */
+  old_level = intr_disable ();
+  for (i = 0; i < MEMTRACK_SITES; i++)
+    {
+      struct site *s = &sites[i];
+      if (s->caller == NULL)
+        continue;
+
+      total_bytes += s->live_bytes;
+      if (s->history_cnt == MEMTRACK_HISTORY)
+        memmove (s->history, s->history + 1,
+                 sizeof *s->history * (MEMTRACK_HISTORY - 1));
+      else
+        s->history_cnt++;
+      s->history[s->history_cnt - 1] = s->live_cnt;
+
+      if (top_cnt < MEMTRACK_TOP)
+        top[top_cnt++] = *s;
+      else if (s->live_bytes > top[MEMTRACK_TOP - 1].live_bytes)
+        top[MEMTRACK_TOP - 1] = *s;
+      qsort (top, top_cnt, sizeof *top, compare_live_bytes);
+
+      if (is_suspected_leak (s) && leak_cnt < MEMTRACK_TOP)
+        leaks[leak_cnt++] = *s;
+      s->dump_alloc_cnt = s->alloc_cnt;
+    }
+  dump_ticks = now;
+  intr_set_level (old_level);
+
+  printf ("Memory tracking: %zu bytes live in %zu allocations, "
+          "%lu not tracked.\n", total_bytes, live_used, dropped_cnt);
+  printf ("%-10s  %-6s  %10s  %8s  %10s\n",
+          "caller", "kind", "live bytes", "live cnt", "allocs/s");
+  for (i = 0; i < top_cnt; i++)
+    {
+      const struct site *s = &top[i];
+      uint64_t allocs = s->alloc_cnt - s->dump_alloc_cnt;
+      printf ("%10p  %-6s  %10zu  %8zu  %10"PRIu64"\n",
+              s->caller, s->kind == MEMTRACK_MALLOC ? "malloc" : "palloc",
+              s->live_bytes, s->live_cnt, allocs * TIMER_FREQ / elapsed);
+    }
+  for (i = 0; i < leak_cnt; i++)
+    printf ("Suspected leak at %p: live count grew to %zu over "
+            "the last %d dumps.\n",
+            leaks[i].caller, leaks[i].live_cnt, MEMTRACK_HISTORY);
+}
+
+/* Returns CALLER's site, creating it if necessary, or a null
+   pointer if the site table is full. */
+static struct site *
+find_site (const void *caller, enum memtrack_kind kind)
+{
+  size_t start = hash_bytes (&caller, sizeof caller) % MEMTRACK_SITES;
+  size_t i;
+
+  for (i = 0; i < MEMTRACK_SITES; i++)
+    {
+      struct site *s = &sites[(start + i) % MEMTRACK_SITES];
+      if (s->caller == caller)
+        return s;
+      else if (s->caller == NULL)
+        {
+          s->caller = caller;
+          s->kind = kind;
+          return s;
+        }
+    }
+  return NULL;
+}
+
+/* Returns the slot that holds P, or the empty slot where P
+   belongs if P is not in the table. */
+static struct live *
+find_live (const void *p)
+{
+  size_t i = hash_bytes (&p, sizeof p) % live_cap;
+
+  while (live[i].p != NULL && live[i].p != p)
+    i = (i + 1) % live_cap;
+  return &live[i];
+}
+
+/* Empties slot L, moving later entries of its probe sequence
+   back so that find_live() still finds them. */
+static void
+remove_live (struct live *l)
+{
+  size_t hole = l - live;
+  size_t i = hole;
+
+  for (;;)
+    {
+      size_t home;
+
+      i = (i + 1) % live_cap;
+      if (live[i].p == NULL)
+        break;
+
+      /* Move entry I into the hole unless its home slot lies
+         cyclically within (HOLE, I]. */
+      home = hash_bytes (&live[i].p, sizeof live[i].p) % live_cap;
+      if (hole <= i ? (hole < home && home <= i) : (hole < home || home <= i))
+        continue;
+      live[hole] = live[i];
+      hole = i;
+    }
+  live[hole].p = NULL;
+  live_used--;
+}
+#endif /* MEMTRACK */
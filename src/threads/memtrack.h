@@ -0,0 +1,43 @@
+#ifndef THREADS_MEMTRACK_H
+#define THREADS_MEMTRACK_H
+
+#include <stddef.h>
+
+/* Allocation-site accounting for malloc() and the page allocator.
+
+   Tracking is opt-in: it is compiled in only when MEMTRACK is
+   defined, e.g. by adding
+        kernel.bin: DEFINES += -DMEMTRACK
+   to a project's Make.vars.  Otherwise every hook below expands
+   to nothing and costs nothing.
+
+   Pages that malloc() obtains for its own arenas are charged to
+   palloc call sites inside malloc.c. */
+
+/* Kind of allocation. */
+enum memtrack_kind
+  {
+    MEMTRACK_MALLOC,            /* malloc(), calloc(), realloc(). */
+    MEMTRACK_PALLOC             /* palloc_get_page/multiple(). */
+  };
+
+#ifdef MEMTRACK
+/* Address that the current function will return to. */
+#define MEMTRACK_CALLER() __builtin_return_address (0)
+
+void memtrack_init (void);
+void memtrack_alloc (enum memtrack_kind, const void *, size_t,
+                     const void *caller);
+void memtrack_resize (const void *, size_t);
+void memtrack_free (const void *);
+void memtrack_dump (void);
+#else
+#define MEMTRACK_CALLER() NULL
+#define memtrack_init() ((void) 0)
+#define memtrack_alloc(KIND, P, SIZE, CALLER) ((void) 0)
+#define memtrack_resize(P, SIZE) ((void) 0)
+#define memtrack_free(P) ((void) 0)
+#define memtrack_dump() ((void) 0)
+#endif
+
+#endif /* threads/memtrack.h */
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/loader.h"
+#include "threads/memtrack.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -90,11 +91,16 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
     {
       if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
+      memtrack_alloc (MEMTRACK_PALLOC, pages, PGSIZE * page_cnt,
+                      MEMTRACK_CALLER ());
     }
   else 
     {
       if (flags & PAL_ASSERT)
-        PANIC ("palloc_get: out of pages");
+        {
+          memtrack_dump ();
+          PANIC ("palloc_get: out of pages");
+        }
     }
 
   return pages;
@@ -110,7 +116,56 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 void *
 palloc_get_page (enum palloc_flags flags) 
 {
-  return palloc_get_multiple (flags, 1);
+  void *page = palloc_get_multiple (flags, 1);
+  memtrack_alloc (MEMTRACK_PALLOC, page, PGSIZE, MEMTRACK_CALLER ());
+  return page;
+}
+
+/* Tries to grow the run of OLD_CNT pages starting at PAGES,
+   previously obtained from palloc_get_multiple(), to NEW_CNT
+   pages without moving it.  Succeeds only if the pages that
+   immediately follow the run are free and in the same pool.
+   The new pages are zeroed if PAL_ZERO is set in FLAGS.
+   Returns true if successful, false otherwise. */
+bool
+palloc_extend_multiple (enum palloc_flags flags, void *pages,
+                        size_t old_cnt, size_t new_cnt)
+{
+  struct pool *pool;
+  size_t page_idx, extra_cnt;
+  bool success = false;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (new_cnt >= old_cnt);
+  if (new_cnt == old_cnt)
+    return true;
+
+  if (page_from_pool (&kernel_pool, pages))
+    pool = &kernel_pool;
+  else if (page_from_pool (&user_pool, pages))
+    pool = &user_pool;
+  else
+    NOT_REACHED ();
+
+  page_idx = pg_no (pages) - pg_no (pool->base) + old_cnt;
+  extra_cnt = new_cnt - old_cnt;
+
+  lock_acquire (&pool->lock);
+  if (page_idx + extra_cnt <= bitmap_size (pool->used_map)
+      && bitmap_none (pool->used_map, page_idx, extra_cnt))
+    {
+      bitmap_set_multiple (pool->used_map, page_idx, extra_cnt, true);
+      success = true;
+    }
+  lock_release (&pool->lock);
+
+  if (success)
+    {
+      if (flags & PAL_ZERO)
+        memset ((uint8_t *) pages + old_cnt * PGSIZE, 0, extra_cnt * PGSIZE);
+      memtrack_resize (pages, PGSIZE * new_cnt);
+    }
+  return success;
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -133,6 +188,8 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 
   page_idx = pg_no (pages) - pg_no (pool->base);
 
+  memtrack_free (pages);
+
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
@@ -408,6 +408,101 @@ cond_broadcast (struct condition *cond, struct lock *lock)
     cond_signal (cond, lock);
 }
 
+/* Initializes RWLOCK.  A readers-writer lock can be held by any
+   number of readers at once, or by a single writer.
+
+   Waiting writers keep new readers out, so that a steady stream
+   of readers cannot starve them.  As a consequence, a thread
+   must not acquire a readers-writer lock for reading while
+   already holding it, since a writer that arrived in between
+   would deadlock with it. */
+void
+rwlock_init (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_init (&rwlock->lock);
+  cond_init (&rwlock->readers);
+  cond_init (&rwlock->writers);
+  rwlock->reader_cnt = 0;
+  rwlock->writer_waiters = 0;
+  rwlock->writer = NULL;
+}
+
+/* Acquires RWLOCK for reading, sleeping until no writer holds it
+   or waits for it. */
+void
+rwlock_acquire_read (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+  ASSERT (rwlock->writer != thread_current ());
+
+  lock_acquire (&rwlock->lock);
+  while (rwlock->writer != NULL || rwlock->writer_waiters > 0)
+    cond_wait (&rwlock->readers, &rwlock->lock);
+  rwlock->reader_cnt++;
+  lock_release (&rwlock->lock);
+}
+
+/* Releases RWLOCK, which the current thread holds for
+   reading. */
+void
+rwlock_release_read (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->lock);
+  ASSERT (rwlock->reader_cnt > 0);
+  if (--rwlock->reader_cnt == 0)
+    cond_signal (&rwlock->writers, &rwlock->lock);
+  lock_release (&rwlock->lock);
+}
+
+/* Acquires RWLOCK for writing, sleeping until nobody else holds
+   it. */
+void
+rwlock_acquire_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+  ASSERT (rwlock->writer != thread_current ());
+
+  lock_acquire (&rwlock->lock);
+  rwlock->writer_waiters++;
+  while (rwlock->writer != NULL || rwlock->reader_cnt > 0)
+    cond_wait (&rwlock->writers, &rwlock->lock);
+  rwlock->writer_waiters--;
+  rwlock->writer = thread_current ();
+  lock_release (&rwlock->lock);
+}
+
+/* Releases RWLOCK, which the current thread holds for writing.
+   Lets in the next waiting writer if there is one, otherwise
+   every waiting reader. */
+void
+rwlock_release_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_acquire (&rwlock->lock);
+  ASSERT (rwlock->writer == thread_current ());
+  rwlock->writer = NULL;
+  if (rwlock->writer_waiters > 0)
+    cond_signal (&rwlock->writers, &rwlock->lock);
+  else
+    cond_broadcast (&rwlock->readers, &rwlock->lock);
+  lock_release (&rwlock->lock);
+}
+
+/* Returns true if the current thread holds RWLOCK for writing,
+   false otherwise. */
+bool
+rwlock_held_for_write (const struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  return rwlock->writer == thread_current ();
+}
+
 /*
 semaphore_elem variation of little_less_func implementation used when running
 list_insert_ordered into conditional variable's waiters list based on priority. 
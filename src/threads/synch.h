@@ -41,6 +41,24 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition readers;   /* Signaled when readers may enter. */
+    struct condition writers;   /* Signaled when a writer may enter. */
+    unsigned reader_cnt;        /* Number of readers holding it. */
+    unsigned writer_waiters;    /* Number of writers waiting. */
+    struct thread *writer;      /* Writer holding it, if any. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 // List compare sorting functions
 bool sema_has_greater_priority (const struct list_elem *a_,
                                 const struct list_elem *b_, void *aux);
@@ -649,6 +649,18 @@ init_thread (struct thread *t, const char *name, int priority)
   list_init(&t->priority_donors);
   t->waiting_for = NULL; 
 
+#ifdef USERPROG
+  t->exit_code = -1;
+  t->wait_status = NULL;
+  list_init (&t->children);
+  list_init (&t->fds);
+  t->next_fd = 2;
+#endif
+#ifdef VM
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+#endif
+
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
   intr_set_level (old_level);
@@ -4,6 +4,9 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#ifdef VM
+#include <hash.h>
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -107,6 +110,42 @@ struct thread
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+    int exit_code;                      /* Exit status. */
+    struct wait_status *wait_status;    /* Shared with parent, or null. */
+    struct list children;               /* Children's wait_status. */
+
+    /* Owned by userprog/syscall.c. */
+    struct list fds;                    /* Open file descriptors. */
+    int next_fd;                        /* Next file descriptor to assign. */
+    void *user_esp;                     /* User stack pointer in syscall. */
+    bool in_user_copy;                  /* In get_user() or put_user()? */
+
+    /* Owned by userprog/exception.c. */
+    unsigned long fault_cnt;            /* Page faults taken. */
+#endif
+
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct file *exec_file;             /* Executable, for demand paging. */
+    void *stack_bottom;                 /* Lowest page of user stack. */
+
+    /* Owned by vm/frame.c. */
+    size_t rss;                         /* Resident pages. */
+    size_t wss;                         /* Estimated working set, in pages. */
+    size_t ws_cnt;                      /* Pages accessed in current sample. */
+    size_t rss_soft_limit;              /* Resident set soft limit, or 0. */
+    size_t rss_hard_limit;              /* Resident set hard limit, or 0. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping id to assign. */
+#endif
+
+#ifdef FILESYS
+    /* Owned by filesys/journal.c. */
+    unsigned journal_depth;             /* Nesting of journal_begin(). */
+    size_t journal_reserved;            /* Sectors reserved, not yet logged. */
 #endif
   };
 
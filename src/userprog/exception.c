@@ -4,6 +4,10 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -142,15 +146,52 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  thread_current ()->fault_cnt++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* Bring in the page if it is part of the process's address
+     space but hasn't been loaded yet, or if the process is
+     growing its stack.  A fault in the kernel comes from a
+     system call, so use the stack pointer saved on entry. */
+  if (not_present && is_user_vaddr (fault_addr)
+      && (page_load (fault_addr, write)
+          || page_grow_stack (fault_addr,
+                              user ? f->esp : thread_current ()->user_esp)))
+    return;
+
+  /* Give the process its own copy of a page that it shares
+     copy-on-write with another process. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && page_copy_on_write (fault_addr))
+    return;
+#endif
+
+  /* A bad user address passed to a system call.  get_user() and
+     put_user() in syscall.c leave the address to resume at in
+     EAX; resume there, with EAX cleared to report the fault. */
+  if (!user && is_user_vaddr (fault_addr)
+      && thread_current ()->in_user_copy)
+    {
+      f->eip = (void (*) (void)) f->eax;
+      f->eax = 0;
+      return;
+    }
+
+  /* Any other kernel fault on a user address of a process, such
+     as a direct copy to a user buffer whose page could not be
+     brought back in because swap is full, kills the process.
+     Page 0 is never mapped and system calls check pointers
+     before using them directly, so a fault there is a kernel
+     bug, which kill() panics on. */
+  if (!user && is_user_vaddr (fault_addr) && pg_no (fault_addr) != 0
+      && thread_current ()->pagedir != NULL)
+    thread_exit ();
+
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
@@ -6,8 +6,15 @@
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+/* Largest number of pages that invalidate_range() invalidates
+   one by one.  Beyond this, flushing the TLB's user entries
+   with a CR3 reload is cheaper than the INVLPGs plus the misses
+   they save. */
+#define INVLPG_MAX 32
+
 static uint32_t *active_pd (void);
-static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
+static void invalidate_range (uint32_t *, const void *, size_t page_cnt);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -66,6 +73,12 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
   /* Check for a page table for VADDR.
      If one is missing, create one if requested. */
   pde = pd + pd_no (vaddr);
+  if (*pde & PTE_PS)
+    {
+      /* Kernel memory mapped with a large page has no page
+         table. */
+      return NULL;
+    }
   if (*pde == 0) 
     {
       if (create)
@@ -152,8 +165,29 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
+    }
+}
+
+/* Marks the PAGE_CNT user virtual pages starting at UPAGE "not
+   present" in PD, like calling pagedir_clear_page() on each of
+   them, but invalidates the TLB only once for all of them. */
+void
+pagedir_clear_range (uint32_t *pd, void *upage, size_t page_cnt)
+{
+  uint8_t *p = upage;
+  size_t i;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (p + (page_cnt - 1) * PGSIZE));
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      uint32_t *pte = lookup_page (pd, p + i * PGSIZE, false);
+      if (pte != NULL)
+        *pte &= ~PTE_P;
     }
+  invalidate_range (pd, upage, page_cnt);
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
@@ -180,7 +214,25 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
+        }
+    }
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        {
+          *pte &= ~(uint32_t) PTE_W;
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -209,7 +261,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -222,6 +274,11 @@ pagedir_activate (uint32_t *pd)
   if (pd == NULL)
     pd = init_page_dir;
 
+  /* Loading CR3 flushes the TLB, so don't if PD is already
+     active. */
+  if (active_pd () == pd)
+    return;
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -245,19 +302,43 @@ active_pd (void)
 
 /* Seom page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
-   table.  When this happens, we have to "invalidate" the TLB by
-   re-activating it.
+   table.  When this happens, we have to "invalidate" the TLB
+   entries involved.
+
+   This function invalidates the TLB entry for VADDR if PD is the
+   active page directory.  (If PD is not active then its entries
+   are not in the TLB, so there is no need to invalidate
+   anything.)  See [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vaddr)
+{
+  if (active_pd () == pd)
+    asm volatile ("invlpg %0" : : "m" (*(const char *) vaddr) : "memory");
+}
 
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+/* Invalidates the TLB entries for the PAGE_CNT pages starting at
+   VADDR if PD is the active page directory, either one at a time
+   or, for large ranges, all of the TLB's non-global entries at
+   once. */
 static void
-invalidate_pagedir (uint32_t *pd) 
+invalidate_range (uint32_t *pd, const void *vaddr, size_t page_cnt)
 {
-  if (active_pd () == pd) 
+  if (active_pd () == pd)
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
-    } 
+      if (page_cnt <= INVLPG_MAX)
+        {
+          const char *p = vaddr;
+          size_t i;
+
+          for (i = 0; i < page_cnt; i++)
+            asm volatile ("invlpg %0" : : "m" (p[i * PGSIZE]) : "memory");
+        }
+      else
+        {
+          /* Reloading CR3 flushes the TLB, except for global
+             kernel entries.  See [IA32-v3a] 3.12 "Translation
+             Lookaside Buffers (TLBs)". */
+          asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+        }
+    }
 }
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -14,55 +15,120 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Lets a parent process wait for a child to exit and collect its
+   exit code.  Shared by the two, and freed by whichever of them
+   lets go of it last. */
+struct wait_status
+  {
+    struct list_elem elem;      /* Element in parent's `children'. */
+    struct lock lock;           /* Protects ref_cnt. */
+    int ref_cnt;                /* Number of processes holding this. */
+    tid_t tid;                  /* Child's thread id. */
+    int exit_code;              /* Child's exit code, once dead. */
+    struct semaphore dead;      /* Upped when the child exits. */
+  };
 
-static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
+/* Information passed from a process to a child started by
+   process_execute(). */
+struct exec_info
+  {
+    char *cmd_line;                     /* Page holding command line. */
+    struct wait_status *wait_status;    /* Child's wait status. */
+    struct semaphore loaded;            /* Upped once the child loads. */
+    bool success;                       /* Whether the load succeeded. */
+  };
 
-/* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+static thread_func start_process NO_RETURN;
+static bool load (const char *cmd_line, void (**eip) (void), void **esp);
+static struct wait_status *wait_status_create (void);
+static void wait_status_release (struct wait_status *);
+
+/* Starts a new thread running a user program loaded from the
+   file named by the first word of CMD_LINE, passing it the words
+   of CMD_LINE as arguments.  Waits for the program to load.
+   Returns the new process's thread id, or TID_ERROR if the
+   thread cannot be created or the program cannot be loaded. */
 tid_t
-process_execute (const char *file_name) 
+process_execute (const char *cmd_line) 
 {
-  char *fn_copy;
+  struct exec_info exec;
+  char thread_name[16];
+  char *save_ptr;
   tid_t tid;
 
-  /* Make a copy of FILE_NAME.
-     Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+  /* Make a copy of CMD_LINE for the child to parse. */
+  exec.cmd_line = palloc_get_page (0);
+  if (exec.cmd_line == NULL)
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
+  strlcpy (exec.cmd_line, cmd_line, PGSIZE);
+  exec.wait_status = wait_status_create ();
+  if (exec.wait_status == NULL)
+    {
+      palloc_free_page (exec.cmd_line);
+      return TID_ERROR;
+    }
+  sema_init (&exec.loaded, 0);
+  exec.success = false;
+
+  /* Name the thread after the program. */
+  strlcpy (thread_name, cmd_line, sizeof thread_name);
+  strtok_r (thread_name, " ", &save_ptr);
 
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
+  /* Create a new thread to execute CMD_LINE and wait for it to
+     load, since EXEC lives on our stack. */
+  tid = thread_create (thread_name, PRI_DEFAULT, start_process, &exec);
   if (tid == TID_ERROR)
-    palloc_free_page (fn_copy); 
+    {
+      palloc_free_page (exec.cmd_line);
+      free (exec.wait_status);
+      return TID_ERROR;
+    }
+  sema_down (&exec.loaded);
+  if (!exec.success)
+    {
+      wait_status_release (exec.wait_status);
+      return TID_ERROR;
+    }
+  list_push_back (&thread_current ()->children, &exec.wait_status->elem);
   return tid;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *exec_)
 {
-  char *file_name = file_name_;
+  struct exec_info *exec = exec_;
+  struct thread *t = thread_current ();
   struct intr_frame if_;
   bool success;
 
+  t->wait_status = exec->wait_status;
+  t->wait_status->tid = t->tid;
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load (file_name, &if_.eip, &if_.esp);
+  success = load (exec->cmd_line, &if_.eip, &if_.esp);
+
+  /* Tell our parent how the load went.  EXEC is gone once we
+     up its semaphore. */
+  palloc_free_page (exec->cmd_line);
+  exec->success = success;
+  sema_up (&exec->loaded);
 
   /* If load failed, quit. */
-  palloc_free_page (file_name);
   if (!success) 
     thread_exit ();
 
@@ -76,18 +142,122 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Information passed from a process to its child by fork(). */
+struct fork_info
+  {
+    struct thread *parent;      /* Process that called fork(). */
+    struct intr_frame if_;      /* Parent's user context. */
+    struct wait_status *wait_status;    /* Child's wait status. */
+    struct semaphore done;      /* Upped once the child is set up. */
+    bool success;               /* Whether the child was set up. */
+  };
+
+static thread_func start_fork NO_RETURN;
+
+/* Creates a child process that duplicates the current one and
+   resumes in user mode from the context in IF_, with fork()
+   returning 0 in the child.  Memory is shared copy-on-write, so
+   this takes time proportional to the number of pages in the
+   process, not to their size.  Returns the child's thread id,
+   or TID_ERROR if the child cannot be created. */
+tid_t
+process_fork (const struct intr_frame *if_)
+{
+  struct fork_info info;
+  tid_t tid;
+
+  info.parent = thread_current ();
+  info.if_ = *if_;
+  info.wait_status = wait_status_create ();
+  if (info.wait_status == NULL)
+    return TID_ERROR;
+  sema_init (&info.done, 0);
+  info.success = false;
+
+  /* Wait for the child to finish copying our address space,
+     which must not change underneath it. */
+  tid = thread_create (info.parent->name, thread_get_priority (),
+                       start_fork, &info);
+  if (tid == TID_ERROR)
+    {
+      free (info.wait_status);
+      return TID_ERROR;
+    }
+  sema_down (&info.done);
+  if (!info.success)
+    {
+      wait_status_release (info.wait_status);
+      return TID_ERROR;
+    }
+  list_push_back (&info.parent->children, &info.wait_status->elem);
+  return tid;
+}
+
+/* A thread function that sets up a process forked from
+   INFO_->parent and starts it running. */
+static void
+start_fork (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *parent = info->parent;
+  struct thread *t = thread_current ();
+  struct intr_frame if_ = info->if_;
+  bool success = false;
+
+  t->wait_status = info->wait_status;
+  t->wait_status->tid = t->tid;
+  t->pagedir = pagedir_create ();
+  if (t->pagedir != NULL && page_table_init ())
+    {
+      t->exec_file = file_reopen (parent->exec_file);
+      if (t->exec_file != NULL)
+        {
+          file_deny_write (t->exec_file);
+          success = page_table_copy (parent) && syscall_fork (parent);
+        }
+    }
+  process_activate ();
+
+  info->success = success;
+  sema_up (&info->done);
+  if (!success)
+    thread_exit ();
+
+  /* Return 0 from fork() in the child. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
    child of the calling process, or if process_wait() has already
    been successfully called for the given TID, returns -1
-   immediately, without waiting.
-
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   immediately, without waiting. */
 int
-process_wait (tid_t child_tid UNUSED) 
+process_wait (tid_t child_tid) 
 {
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->children); e != list_end (&cur->children);
+       e = list_next (e))
+    {
+      struct wait_status *ws = list_entry (e, struct wait_status, elem);
+      if (ws->tid == child_tid)
+        {
+          int exit_code;
+
+          list_remove (e);
+          sema_down (&ws->dead);
+          exit_code = ws->exit_code;
+          wait_status_release (ws);
+          return exit_code;
+        }
+    }
   return -1;
 }
 
@@ -97,6 +267,23 @@ process_exit (void)
 {
   struct thread *cur = thread_current ();
   uint32_t *pd;
+  struct list_elem *e;
+
+  if (cur->pagedir != NULL)
+    printf ("%s: exit(%d)\n", cur->name, cur->exit_code);
+
+  /* Close open files and unmap memory-mapped files. */
+  syscall_exit ();
+
+#ifdef VM
+  /* Destroy the supplemental page table, freeing the process's
+     frames, and close the executable that its pages were being
+     loaded from.  This must precede destroying the page
+     directory, which evictions in progress may still use. */
+  page_table_destroy ();
+  file_close (cur->exec_file);
+  cur->exec_file = NULL;
+#endif
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -114,6 +301,52 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+  /* Report our exit code to our parent, if it is still around to
+     wait for it, and let go of our children's wait statuses. */
+  if (cur->wait_status != NULL)
+    {
+      cur->wait_status->exit_code = cur->exit_code;
+      sema_up (&cur->wait_status->dead);
+      wait_status_release (cur->wait_status);
+      cur->wait_status = NULL;
+    }
+  while (!list_empty (&cur->children))
+    {
+      e = list_pop_front (&cur->children);
+      wait_status_release (list_entry (e, struct wait_status, elem));
+    }
+}
+
+/* Creates a wait status for a new child, held both by the child
+   and by the current process.  Returns a null pointer if memory
+   is exhausted. */
+static struct wait_status *
+wait_status_create (void)
+{
+  struct wait_status *ws = malloc (sizeof *ws);
+  if (ws != NULL)
+    {
+      lock_init (&ws->lock);
+      ws->ref_cnt = 2;
+      ws->tid = TID_ERROR;
+      ws->exit_code = -1;
+      sema_init (&ws->dead, 0);
+    }
+  return ws;
+}
+
+/* Drops a reference to WS, freeing it if it was the last. */
+static void
+wait_status_release (struct wait_status *ws)
+{
+  int ref_cnt;
+
+  lock_acquire (&ws->lock);
+  ref_cnt = --ws->ref_cnt;
+  lock_release (&ws->lock);
+  if (ref_cnt == 0)
+    free (ws);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -124,8 +357,14 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel thread has no user
+     address space and can run on any page directory, since they
+     all map the kernel the same way, so leave the previous
+     thread's page directory active to avoid flushing the TLB.
+     A process frees its page directory only after switching
+     away from it, in process_exit(). */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -195,22 +434,26 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
-static bool setup_stack (void **esp);
+static bool setup_stack (const char *cmd_line, void **esp);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
+/* Loads an ELF executable, named by the first word of CMD_LINE,
+   into the current thread, passing it the words of CMD_LINE as
+   arguments.
    Stores the executable's entry point into *EIP
    and its initial stack pointer into *ESP.
    Returns true if successful, false otherwise. */
 bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+load (const char *cmd_line, void (**eip) (void), void **esp) 
 {
   struct thread *t = thread_current ();
   struct Elf32_Ehdr ehdr;
   struct file *file = NULL;
+  char *cmd_line_copy = NULL;
+  char *file_name, *save_ptr;
   off_t file_ofs;
   bool success = false;
   int i;
@@ -220,6 +463,19 @@ load (const char *file_name, void (**eip) (void), void **esp)
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  if (!page_table_init ())
+    goto done;
+#endif
+
+  /* Extract file name. */
+  cmd_line_copy = palloc_get_page (0);
+  if (cmd_line_copy == NULL)
+    goto done;
+  strlcpy (cmd_line_copy, cmd_line, PGSIZE);
+  file_name = strtok_r (cmd_line_copy, " ", &save_ptr);
+  if (file_name == NULL)
+    goto done;
 
   /* Open executable file. */
   file = filesys_open (file_name);
@@ -302,7 +558,7 @@ load (const char *file_name, void (**eip) (void), void **esp)
     }
 
   /* Set up stack. */
-  if (!setup_stack (esp))
+  if (!setup_stack (cmd_line, esp))
     goto done;
 
   /* Start address. */
@@ -312,13 +568,28 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+  palloc_free_page (cmd_line_copy);
+#ifdef VM
+  /* Keep the executable open so that its pages can be loaded on
+     demand, and keep it from changing underneath us. */
+  if (success)
+    {
+      file_deny_write (file);
+      t->exec_file = file;
+    }
+  else
+    file_close (file);
+#else
   file_close (file);
+#endif
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -377,6 +648,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are only recorded in the supplemental page
+   table here and are read in by the page fault handler on first
+   access, so loading takes the same time regardless of segment
+   size.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -387,6 +663,40 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+      bool success;
+
+      /* Read-only pages are shared, through the page cache, with
+         every other process running the same executable.  If
+         another process has them in memory already, map them
+         now instead of waiting for a page fault. */
+      if (page_read_bytes > 0 && !writable)
+        {
+          success = page_add_shared (upage, file, ofs, page_read_bytes,
+                                     false);
+          if (success)
+            page_prefault (upage);
+        }
+      else if (page_read_bytes > 0)
+        success = page_add_file (upage, file, ofs, page_read_bytes, writable);
+      else
+        success = page_add_zero (upage, writable);
+      if (!success)
+        return false;
+
+      /* Advance. */
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
+
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -422,28 +732,127 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
     }
   return true;
+#endif
+}
+
+/* Pushes SIZE bytes from BUF onto the stack being built in
+   KPAGE, whose top is at offset *OFS, keeping the stack pointer
+   word-aligned.  Returns the address of the copy in KPAGE, or a
+   null pointer if the page is full. */
+static void *
+push (uint8_t *kpage, size_t *ofs, const void *buf, size_t size) 
+{
+  size_t padsize = ROUND_UP (size, sizeof (uint32_t));
+  if (*ofs < padsize)
+    return NULL;
+
+  *ofs -= padsize;
+  memcpy (kpage + *ofs + (padsize - size), buf, size);
+  return kpage + *ofs + (padsize - size);
 }
 
-/* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+/* Reverses the order of the ARGC pointers in ARGV. */
+static void
+reverse (int argc, char **argv) 
+{
+  for (; argc > 1; argc -= 2, argv++) 
+    {
+      char *tmp = argv[0];
+      argv[0] = argv[argc - 1];
+      argv[argc - 1] = tmp;
+    }
+}
+
+/* Builds, in KPAGE, the initial stack for a program started with
+   the words of CMD_LINE as arguments, laid out as the 80x86 calling
+   convention expects for a call to main (argc, argv) that will
+   be mapped at user virtual address UPAGE.  Stores the initial
+   stack pointer into *ESP.  Returns true if successful, false if
+   the arguments do not fit in a page. */
 static bool
-setup_stack (void **esp) 
+init_cmd_line (uint8_t *kpage, uint8_t *upage, const char *cmd_line,
+               void **esp) 
 {
+  size_t ofs = PGSIZE;
+  char *const null = NULL;
+  char *cmd_line_copy;
+  char *karg, *save_ptr;
+  int argc;
+  char **argv;
+
+  /* Push command line string. */
+  cmd_line_copy = push (kpage, &ofs, cmd_line, strlen (cmd_line) + 1);
+  if (cmd_line_copy == NULL)
+    return false;
+
+  /* Push argv[argc], then split the command line into words in
+     place and push pointers to them, last word nearest the top. */
+  if (push (kpage, &ofs, &null, sizeof null) == NULL)
+    return false;
+  argc = 0;
+  for (karg = strtok_r (cmd_line_copy, " ", &save_ptr); karg != NULL;
+       karg = strtok_r (NULL, " ", &save_ptr))
+    {
+      void *uarg = upage + (karg - (char *) kpage);
+      if (push (kpage, &ofs, &uarg, sizeof uarg) == NULL)
+        return false;
+      argc++;
+    }
+  argv = (char **) (upage + ofs);
+  reverse (argc, (char **) (kpage + ofs));
+
+  /* Push argv, argc, and a fake return address. */
+  if (push (kpage, &ofs, &argv, sizeof argv) == NULL
+      || push (kpage, &ofs, &argc, sizeof argc) == NULL
+      || push (kpage, &ofs, &null, sizeof null) == NULL)
+    return false;
+
+  *esp = upage + ofs;
+  return true;
+}
+
+/* Create a stack by mapping a zeroed page at the top of user
+   virtual memory and pushing the arguments in CMD_LINE onto it. */
+static bool
+setup_stack (const char *cmd_line, void **esp) 
+{
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+#ifdef VM
+  /* Build the stack in a scratch page, then copy it into the
+     process's stack page, which page faults bring back in if it
+     is evicted in the meantime. */
+  uint8_t *kpage;
+  bool success = false;
+
+  kpage = palloc_get_page (PAL_ZERO);
+  if (kpage == NULL)
+    return false;
+  if (init_cmd_line (kpage, upage, cmd_line, esp)
+      && page_add_zero (upage, true) && page_load (upage, true))
+    {
+      thread_current ()->stack_bottom = upage;
+      memcpy (*esp, kpage + pg_ofs (*esp), PGSIZE - pg_ofs (*esp));
+      success = true;
+    }
+  palloc_free_page (kpage);
+  return success;
+#else
   uint8_t *kpage;
   bool success = false;
 
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
   if (kpage != NULL) 
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success)
-        *esp = PHYS_BASE;
-      else
+      success = (init_cmd_line (kpage, upage, cmd_line, esp)
+                 && install_page (upage, kpage, true));
+      if (!success)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -463,3 +872,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
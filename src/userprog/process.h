@@ -3,7 +3,10 @@
 
 #include "threads/thread.h"
 
-tid_t process_execute (const char *file_name);
+struct intr_frame;
+
+tid_t process_execute (const char *cmd_line);
+tid_t process_fork (const struct intr_frame *);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
@@ -1,20 +1,578 @@
 #include "userprog/syscall.h"
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include "devices/input.h"
+#include "devices/shutdown.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/mmap.h"
+#endif
+
+/* System calls.
+
+   Arguments are copied out of the user stack one byte at a time
+   with get_user(), which relies on page_fault() to turn a fault
+   on a bad user address into an error return rather than a
+   kernel panic.  User buffers are probed the same way, a byte
+   per page, and then accessed directly; any page that has been
+   evicted in the meantime is simply brought back in by the page
+   fault handler.
+
+   System calls call into the file system without a lock of
+   their own.  The file system locks what it touches: each
+   inode's extents under a readers-writer lock, each directory's
+   entries under its inode's directory lock, and the free map
+   under its own lock, so that calls on different files, and
+   reads of the same file, proceed concurrently. */
+
+/* Memory use of a process, reported by the memstat system call.
+   Must match struct memstat in lib/user/syscall.h. */
+struct memstat
+  {
+    size_t rss;                 /* Pages resident in memory. */
+    size_t wss;                 /* Estimated working set. */
+    unsigned long fault_cnt;    /* Page faults taken. */
+    size_t soft_limit;          /* Resident set soft limit. */
+    size_t hard_limit;          /* Resident set hard limit. */
+  };
+
+/* An open file. */
+struct fd
+  {
+    int handle;                 /* File descriptor. */
+    struct file *file;          /* Open file. */
+    struct list_elem elem;      /* Element in thread's `fds' list. */
+  };
 
 static void syscall_handler (struct intr_frame *);
+static void copy_in (void *, const void *, size_t);
+static char *copy_in_string (const char *);
+static void verify_user (const void *, size_t, bool write);
+static struct fd *lookup_fd (int handle);
+
+static void sys_halt (void) NO_RETURN;
+static void sys_exit (int status) NO_RETURN;
+static tid_t sys_exec (const char *ufile);
+static int sys_wait (tid_t);
+static bool sys_create (const char *ufile, unsigned initial_size);
+static bool sys_remove (const char *ufile);
+static int sys_open (const char *ufile);
+static int sys_filesize (int handle);
+static int sys_read (int handle, void *udst, unsigned size);
+static int sys_write (int handle, const void *usrc, unsigned size);
+static void sys_seek (int handle, unsigned position);
+static int sys_tell (int handle);
+static void sys_close (int handle);
+#ifdef VM
+static mapid_t sys_mmap (int handle, void *addr);
+static void sys_munmap (mapid_t);
+static tid_t sys_fork (struct intr_frame *);
+static bool sys_memstat (struct memstat *ustat);
+static bool sys_memlimit (size_t soft_limit, size_t hard_limit);
+#endif
 
 void
-syscall_init (void) 
+syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
+/* Number of arguments taken by each system call. */
+static const unsigned char arg_cnts[] =
+  {
+    [SYS_HALT] = 0, [SYS_EXIT] = 1, [SYS_EXEC] = 1, [SYS_WAIT] = 1,
+    [SYS_CREATE] = 2, [SYS_REMOVE] = 1, [SYS_OPEN] = 1,
+    [SYS_FILESIZE] = 1, [SYS_READ] = 3, [SYS_WRITE] = 3, [SYS_SEEK] = 2,
+    [SYS_TELL] = 1, [SYS_CLOSE] = 1, [SYS_MMAP] = 2, [SYS_MUNMAP] = 1,
+    [SYS_FORK] = 0, [SYS_MEMSTAT] = 1, [SYS_MEMLIMIT] = 2,
+  };
+
+/* System call handler. */
+static void
+syscall_handler (struct intr_frame *f)
+{
+  unsigned call_nr;
+  int args[3];
+
+  /* The stack may need to grow if the call faults on a buffer
+     in it, so remember where the stack pointer is. */
+  thread_current ()->user_esp = f->esp;
+
+  /* Get the system call and its arguments. */
+  copy_in (&call_nr, f->esp, sizeof call_nr);
+  if (call_nr >= sizeof arg_cnts / sizeof *arg_cnts)
+    thread_exit ();
+  memset (args, 0, sizeof args);
+  copy_in (args, (uint32_t *) f->esp + 1, sizeof *args * arg_cnts[call_nr]);
+
+  /* Execute the system call, and set the return value. */
+  switch (call_nr)
+    {
+    case SYS_HALT:
+      sys_halt ();
+    case SYS_EXIT:
+      sys_exit (args[0]);
+    case SYS_EXEC:
+      f->eax = sys_exec ((const char *) args[0]);
+      break;
+    case SYS_WAIT:
+      f->eax = sys_wait (args[0]);
+      break;
+    case SYS_CREATE:
+      f->eax = sys_create ((const char *) args[0], args[1]);
+      break;
+    case SYS_REMOVE:
+      f->eax = sys_remove ((const char *) args[0]);
+      break;
+    case SYS_OPEN:
+      f->eax = sys_open ((const char *) args[0]);
+      break;
+    case SYS_FILESIZE:
+      f->eax = sys_filesize (args[0]);
+      break;
+    case SYS_READ:
+      f->eax = sys_read (args[0], (void *) args[1], args[2]);
+      break;
+    case SYS_WRITE:
+      f->eax = sys_write (args[0], (const void *) args[1], args[2]);
+      break;
+    case SYS_SEEK:
+      sys_seek (args[0], args[1]);
+      break;
+    case SYS_TELL:
+      f->eax = sys_tell (args[0]);
+      break;
+    case SYS_CLOSE:
+      sys_close (args[0]);
+      break;
+#ifdef VM
+    case SYS_MMAP:
+      f->eax = sys_mmap (args[0], (void *) args[1]);
+      break;
+    case SYS_MUNMAP:
+      sys_munmap (args[0]);
+      break;
+    case SYS_FORK:
+      f->eax = sys_fork (f);
+      break;
+    case SYS_MEMSTAT:
+      f->eax = sys_memstat ((struct memstat *) args[0]);
+      break;
+    case SYS_MEMLIMIT:
+      f->eax = sys_memlimit (args[0], args[1]);
+      break;
+#endif
+    default:
+      thread_exit ();
+    }
+}
+
+/* Gives the current process its own copy of each of PARENT's
+   open files, at the same positions, for fork().  Returns true if
+   successful, false on failure. */
+bool
+syscall_fork (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+  bool success = true;
+
+  for (e = list_begin (&parent->fds); e != list_end (&parent->fds);
+       e = list_next (e))
+    {
+      struct fd *pfd = list_entry (e, struct fd, elem);
+      struct fd *fd = malloc (sizeof *fd);
+
+      if (fd == NULL || (fd->file = file_reopen (pfd->file)) == NULL)
+        {
+          free (fd);
+          success = false;
+          break;
+        }
+      file_seek (fd->file, file_tell (pfd->file));
+      fd->handle = pfd->handle;
+      list_push_back (&cur->fds, &fd->elem);
+    }
+  cur->next_fd = parent->next_fd;
+  return success;
+}
+
+/* Releases the current process's open files and memory
+   mappings.  Called by process_exit(). */
+void
+syscall_exit (void)
+{
+  struct thread *cur = thread_current ();
+
+#ifdef VM
+  mmap_unmap_all ();
+#endif
+  while (!list_empty (&cur->fds))
+    {
+      struct fd *fd = list_entry (list_pop_front (&cur->fds),
+                                  struct fd, elem);
+      file_close (fd->file);
+      free (fd);
+    }
+}
+
+/* Reads a byte at user virtual address USRC into *DST.
+   Returns true if successful, false if a fault occurred.
+   page_fault() only resumes at the address left in EAX while
+   IN_USER_COPY is set. */
+static inline bool
+get_user (uint8_t *dst, const uint8_t *usrc)
+{
+  struct thread *t = thread_current ();
+  int eax;
+
+  if (!is_user_vaddr (usrc))
+    return false;
+  t->in_user_copy = true;
+  asm volatile ("movl $1f, %%eax; movb %2, %%al; movb %%al, %0; 1:"
+                : "=m" (*dst), "=&a" (eax) : "m" (*usrc) : "memory");
+  t->in_user_copy = false;
+  return eax != 0;
+}
+
+/* Writes BYTE to user address UDST.
+   Returns true if successful, false if a fault occurred. */
+static inline bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+  struct thread *t = thread_current ();
+  int eax;
+
+  if (!is_user_vaddr (udst))
+    return false;
+  t->in_user_copy = true;
+  asm volatile ("movl $1f, %%eax; movb %b2, %0; 1:"
+                : "=m" (*udst), "=&a" (eax) : "q" (byte) : "memory");
+  t->in_user_copy = false;
+  return eax != 0;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Terminates the process if any of the user accesses
+   are invalid. */
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+copy_in (void *dst_, const void *usrc_, size_t size)
 {
-  printf ("system call!\n");
+  uint8_t *dst = dst_;
+  const uint8_t *usrc = usrc_;
+
+  for (; size > 0; size--, dst++, usrc++)
+    if (!get_user (dst, usrc))
+      thread_exit ();
+}
+
+/* Creates a copy of user string US in kernel memory and returns
+   it as a page that must be freed with palloc_free_page().
+   Truncates the string at PGSIZE bytes in size.  Terminates the
+   process if any of the user accesses are invalid. */
+static char *
+copy_in_string (const char *us)
+{
+  char *ks;
+  size_t length;
+
+  ks = palloc_get_page (0);
+  if (ks == NULL)
+    thread_exit ();
+
+  for (length = 0; length < PGSIZE; length++)
+    {
+      if (!get_user ((uint8_t *) ks + length, (const uint8_t *) us++))
+        {
+          palloc_free_page (ks);
+          thread_exit ();
+        }
+      if (ks[length] == '\0')
+        return ks;
+    }
+  ks[PGSIZE - 1] = '\0';
+  return ks;
+}
+
+/* Terminates the process unless the SIZE bytes at user address
+   UADDR are mapped and may be read, or written if WRITE is
+   true. */
+static void
+verify_user (const void *uaddr, size_t size, bool write)
+{
+  const uint8_t *p = uaddr;
+  const uint8_t *end = p + size;
+
+  if (size == 0)
+    return;
+  if (end < p)
+    thread_exit ();
+  while (p < end)
+    {
+      uint8_t byte;
+
+      /* Writing back the byte that we read faults if the page is
+         read-only, because the kernel runs with CR0.WP set. */
+      if (!get_user (&byte, p)
+          || (write && !put_user ((uint8_t *) p, byte)))
+        thread_exit ();
+      p = (const uint8_t *) pg_round_down (p) + PGSIZE;
+    }
+}
+
+/* Returns the current process's open file with HANDLE, or a
+   null pointer if there is none. */
+static struct fd *
+lookup_fd (int handle)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->fds); e != list_end (&cur->fds);
+       e = list_next (e))
+    {
+      struct fd *fd = list_entry (e, struct fd, elem);
+      if (fd->handle == handle)
+        return fd;
+    }
+  return NULL;
+}
+
+/* Halt system call. */
+static void
+sys_halt (void)
+{
+  shutdown_power_off ();
+}
+
+/* Exit system call. */
+static void
+sys_exit (int status)
+{
+  thread_current ()->exit_code = status;
   thread_exit ();
 }
+
+/* Exec system call. */
+static tid_t
+sys_exec (const char *ufile)
+{
+  char *kfile = copy_in_string (ufile);
+  tid_t tid = process_execute (kfile);
+
+  palloc_free_page (kfile);
+  return tid;
+}
+
+/* Wait system call. */
+static int
+sys_wait (tid_t child)
+{
+  return process_wait (child);
+}
+
+/* Create system call. */
+static bool
+sys_create (const char *ufile, unsigned initial_size)
+{
+  char *kfile = copy_in_string (ufile);
+  bool ok = filesys_create (kfile, initial_size);
+
+  palloc_free_page (kfile);
+  return ok;
+}
+
+/* Remove system call. */
+static bool
+sys_remove (const char *ufile)
+{
+  char *kfile = copy_in_string (ufile);
+  bool ok = filesys_remove (kfile);
+
+  palloc_free_page (kfile);
+  return ok;
+}
+
+/* Open system call. */
+static int
+sys_open (const char *ufile)
+{
+  char *kfile = copy_in_string (ufile);
+  struct thread *cur = thread_current ();
+  struct fd *fd;
+  int handle = -1;
+
+  fd = malloc (sizeof *fd);
+  if (fd != NULL)
+    {
+      fd->file = filesys_open (kfile);
+      if (fd->file != NULL)
+        {
+          fd->handle = handle = cur->next_fd++;
+          list_push_back (&cur->fds, &fd->elem);
+        }
+      else
+        free (fd);
+    }
+
+  palloc_free_page (kfile);
+  return handle;
+}
+
+/* Filesize system call. */
+static int
+sys_filesize (int handle)
+{
+  struct fd *fd = lookup_fd (handle);
+
+  if (fd == NULL)
+    return -1;
+  return file_length (fd->file);
+}
+
+/* Read system call. */
+static int
+sys_read (int handle, void *udst, unsigned size)
+{
+  struct fd *fd;
+
+  verify_user (udst, size, true);
+  if (handle == STDIN_FILENO)
+    {
+      uint8_t *p = udst;
+      unsigned i;
+
+      for (i = 0; i < size; i++)
+        if (!put_user (p + i, input_getc ()))
+          thread_exit ();
+      return size;
+    }
+
+  fd = lookup_fd (handle);
+  if (fd == NULL)
+    return -1;
+  return file_read (fd->file, udst, size);
+}
+
+/* Write system call. */
+static int
+sys_write (int handle, const void *usrc, unsigned size)
+{
+  struct fd *fd;
+
+  verify_user (usrc, size, false);
+  if (handle == STDOUT_FILENO)
+    {
+      putbuf (usrc, size);
+      return size;
+    }
+
+  fd = lookup_fd (handle);
+  if (fd == NULL)
+    return -1;
+  return file_write (fd->file, usrc, size);
+}
+
+/* Seek system call. */
+static void
+sys_seek (int handle, unsigned position)
+{
+  struct fd *fd = lookup_fd (handle);
+
+  if (fd != NULL && (off_t) position >= 0)
+    file_seek (fd->file, position);
+}
+
+/* Tell system call. */
+static int
+sys_tell (int handle)
+{
+  struct fd *fd = lookup_fd (handle);
+
+  if (fd == NULL)
+    return -1;
+  return file_tell (fd->file);
+}
+
+/* Close system call. */
+static void
+sys_close (int handle)
+{
+  struct fd *fd = lookup_fd (handle);
+
+  if (fd != NULL)
+    {
+      file_close (fd->file);
+      list_remove (&fd->elem);
+      free (fd);
+    }
+}
+
+#ifdef VM
+/* Mmap system call. */
+static mapid_t
+sys_mmap (int handle, void *addr)
+{
+  struct fd *fd = lookup_fd (handle);
+
+  if (fd == NULL)
+    return MAP_FAILED;
+  return mmap_map (fd->file, addr);
+}
+
+/* Munmap system call. */
+static void
+sys_munmap (mapid_t id)
+{
+  mmap_unmap (id);
+}
+
+/* Fork system call. */
+static tid_t
+sys_fork (struct intr_frame *f)
+{
+  return process_fork (f);
+}
+
+/* Memstat system call. */
+static bool
+sys_memstat (struct memstat *ustat)
+{
+  struct thread *cur = thread_current ();
+  struct memstat stat;
+
+  stat.rss = cur->rss;
+  stat.wss = cur->wss;
+  stat.fault_cnt = cur->fault_cnt;
+  stat.soft_limit = cur->rss_soft_limit;
+  stat.hard_limit = cur->rss_hard_limit;
+
+  verify_user (ustat, sizeof *ustat, true);
+  memcpy (ustat, &stat, sizeof stat);
+  return true;
+}
+
+/* Memlimit system call.  The hard limit must not be below the
+   soft limit.  A process that is already over its new hard
+   limit stops growing: from then on it replaces its own pages. */
+static bool
+sys_memlimit (size_t soft_limit, size_t hard_limit)
+{
+  struct thread *cur = thread_current ();
+
+  if (hard_limit != 0 && soft_limit > hard_limit)
+    return false;
+  cur->rss_soft_limit = soft_limit;
+  cur->rss_hard_limit = hard_limit;
+  return true;
+}
+#endif
@@ -0,0 +1,786 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frame table.
+
+   Every frame obtained from the user pool is recorded here along
+   with the page that occupies it and the thread that owns that
+   page.  When the user pool runs dry, frame_alloc() picks a
+   victim with the clock (second-chance) algorithm: the clock
+   hand sweeps the frame list, giving each frame whose page has
+   been accessed since the last sweep another chance and clearing
+   its accessed bit, and evicts the first frame that has not.
+   Having found one victim, the hand keeps going for a short
+   distance to collect up to SWAP_CLUSTER - 1 more unaccessed
+   pages that need writing to swap, so that they all go out in a
+   single sequential write.  The extra frames are returned to the
+   user pool for the allocations that are likely to follow.
+
+   Frames that hold file data for memory-mapped files and for
+   executables' code are also entered in the page cache, a hash
+   table keyed by inode, offset, and length, so that every
+   process that maps the same part of a file shares one frame.
+   The length is part of the key because the tail of a code page
+   is zeroed where a mapping of the same file shows file data.
+
+   A frame in the page cache lists all of the pages mapped to
+   it.  It counts as accessed or dirty if any of its mappings
+   is, and it is written back to its file, rather than to swap,
+   when it is evicted.  A frame leaves the page cache when it is
+   evicted or when its last mapping goes away.
+
+   Frames of ordinary pages are shared, too, after fork(), until
+   a write to one of the pages makes it copy-on-write.  The list
+   of pages in a frame serves as its reference count.
+
+   A frame is pinned while its contents are being read in or
+   written out, so that it cannot be chosen as a victim.  Pinned
+   frames in the page cache are not handed out to new mappers;
+   they wait on CACHE_COND instead.
+
+   Each process's resident set size (RSS) counts its pages that
+   occupy frames, other than the frame of zeros.  A process at
+   its hard limit replaces one of its own pages rather than take
+   a frame from anyone else.  When memory runs short, evict()
+   looks for victims first among processes above their soft
+   limits, then among processes with more pages resident than
+   their working sets, and only then among all processes.  While
+   eviction is going on, every process's working set is
+   estimated every WS_SAMPLE_TICKS timer ticks from the pages it
+   has accessed since the previous sample.  Sampling moves the
+   accessed bits into the pages' REFERENCED flags, where the
+   clock algorithm still sees them. */
+
+/* Timer ticks between working set samples. */
+#define WS_SAMPLE_TICKS (TIMER_FREQ / 4)
+
+/* Kinds of frames that evict() may choose, from most to least
+   preferred. */
+enum victim_class
+  {
+    OWNED,                      /* Frames of one process only. */
+    OVER_SOFT_LIMIT,            /* Owners are above soft limits. */
+    OVER_WORKING_SET,           /* Owners are above working sets. */
+    ANY_FRAME                   /* Any frame. */
+  };
+
+/* Default resident set limits of new processes, in pages, or 0
+   for no limit.  Set with the -rsl and -rsh kernel command-line
+   options. */
+size_t rss_soft_limit_default;
+size_t rss_hard_limit_default;
+
+static struct list frames;          /* All user frames. */
+static size_t frame_cnt;            /* Number of elements in FRAMES. */
+static struct list_elem *hand;      /* Clock hand, an elem in FRAMES. */
+static struct hash cache;           /* Page cache. */
+static struct frame zero_frame;     /* Frame of zeros, never evicted. */
+static struct condition cache_cond; /* Signaled when cache frames unpin. */
+static struct lock frame_lock;      /* Protects the above. */
+
+static hash_hash_func cache_hash;
+static hash_less_func cache_less;
+static struct frame *share (struct page *, struct inode *, off_t,
+                            size_t, bool *, bool may_evict);
+static struct frame *new_frame (struct page *);
+static struct frame *evict (struct thread *);
+static void charge (struct frame *, struct page *, int delta);
+static bool at_hard_limit (const struct thread *);
+static void remove_frame (struct frame *);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  if (!hash_init (&cache, cache_hash, cache_less, NULL))
+    PANIC ("page cache creation failed");
+  cond_init (&cache_cond);
+  lock_init (&frame_lock);
+  hand = list_end (&frames);
+
+  /* The frame of zeros is pinned and is not in the frame table,
+     so that it is never evicted or freed. */
+  zero_frame.kpage = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  list_init (&zero_frame.pages);
+  zero_frame.pinned = true;
+  zero_frame.inode = NULL;
+}
+
+/* Obtains a frame for page P, evicting another page if no free
+   frame is available or if P's owner is at its hard resident
+   set limit, and returns it pinned.  The caller must fill the
+   frame and then call frame_unpin().  P may be null, in which
+   case the caller must add a page with frame_attach() before
+   unpinning the frame.
+   Returns a null pointer if no frame can be obtained. */
+struct frame *
+frame_alloc (struct page *p)
+{
+  struct frame *f = NULL;
+
+  /* Replace one of the owner's own pages if it is at its hard
+     limit.  If all of them are busy, let it go over for now. */
+  if (p != NULL && at_hard_limit (p->owner))
+    f = evict (p->owner);
+  if (f == NULL)
+    {
+      f = new_frame (p);
+      if (f != NULL)
+        return f;
+      f = evict (NULL);
+    }
+  if (f != NULL && p != NULL)
+    {
+      list_push_back (&f->pages, &p->frame_elem);
+      charge (f, p, 1);
+    }
+  return f;
+}
+
+/* Like frame_alloc(), but returns a null pointer instead of
+   evicting a page. */
+struct frame *
+frame_try_alloc (struct page *p)
+{
+  if (p != NULL && at_hard_limit (p->owner))
+    return NULL;
+  return new_frame (p);
+}
+
+/* Obtains a free frame for page P, which may be null, and
+   returns it pinned.  Returns a null pointer if the user pool
+   is empty. */
+static struct frame *
+new_frame (struct page *p)
+{
+  struct frame *f;
+  void *kpage = palloc_get_page (PAL_USER);
+
+  if (kpage == NULL)
+    return NULL;
+  f = malloc (sizeof *f);
+  if (f == NULL)
+    {
+      palloc_free_page (kpage);
+      return NULL;
+    }
+  f->kpage = kpage;
+  list_init (&f->pages);
+  if (p != NULL)
+    {
+      list_push_back (&f->pages, &p->frame_elem);
+      charge (f, p, 1);
+    }
+  f->pinned = true;
+  f->inode = NULL;
+
+  lock_acquire (&frame_lock);
+  list_push_back (&frames, &f->elem);
+  frame_cnt++;
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Obtains the page cache frame for the LENGTH bytes at offset
+   OFS in INODE and adds P to its mappings.  If the frame was
+   already cached, sets *FILL to false and returns it unpinned;
+   it stays in memory at least until the caller releases P's
+   lock.  Otherwise, allocates a frame as frame_alloc() does,
+   enters it in the page cache, sets *FILL to true, and returns
+   it pinned; the caller must then fill it from INODE and call
+   frame_unpin().  If FILL is a null pointer, only an existing
+   frame is returned.
+   Returns a null pointer if no frame can be obtained. */
+struct frame *
+frame_share (struct page *p, struct inode *inode, off_t ofs,
+             size_t length, bool *fill)
+{
+  return share (p, inode, ofs, length, fill, true);
+}
+
+/* Like frame_share(), but never blocks: returns a null pointer
+   instead of waiting if the frame is cached but pinned, and
+   instead of evicting a page if the frame is not cached and no
+   free frame is available. */
+struct frame *
+frame_try_share (struct page *p, struct inode *inode, off_t ofs,
+                 size_t length, bool *fill)
+{
+  return share (p, inode, ofs, length, fill, false);
+}
+
+/* Implements frame_share() and frame_try_share().  Waits for a
+   pinned frame or evicts a page to make room only if MAY_BLOCK
+   is true. */
+static struct frame *
+share (struct page *p, struct inode *inode, off_t ofs, size_t length,
+       bool *fill, bool may_block)
+{
+  struct frame key;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (ofs % PGSIZE == 0);
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.length = length;
+  for (;;)
+    {
+      struct hash_elem *e;
+      struct frame *f;
+
+      lock_acquire (&frame_lock);
+      e = hash_find (&cache, &key.cache_elem);
+      if (e != NULL)
+        {
+          f = hash_entry (e, struct frame, cache_elem);
+          if (f->pinned)
+            {
+              /* Being read in or written out.  Look again once
+                 it is done. */
+              if (!may_block)
+                {
+                  lock_release (&frame_lock);
+                  return NULL;
+                }
+              cond_wait (&cache_cond, &frame_lock);
+              lock_release (&frame_lock);
+              continue;
+            }
+          list_push_back (&f->pages, &p->frame_elem);
+          charge (f, p, 1);
+          lock_release (&frame_lock);
+          if (fill != NULL)
+            *fill = false;
+          return f;
+        }
+      lock_release (&frame_lock);
+      if (fill == NULL)
+        return NULL;
+
+      f = may_block ? frame_alloc (p) : frame_try_alloc (p);
+      if (f == NULL)
+        return NULL;
+
+      lock_acquire (&frame_lock);
+      f->inode = inode;
+      f->ofs = ofs;
+      f->length = length;
+      if (hash_insert (&cache, &f->cache_elem) == NULL)
+        {
+          f->inode = inode_reopen (inode);
+          lock_release (&frame_lock);
+          *fill = true;
+          return f;
+        }
+
+      /* Someone else cached this part of the file while we were
+         allocating.  Use theirs. */
+      f->inode = NULL;
+      lock_release (&frame_lock);
+      frame_free (f);
+    }
+}
+
+/* Adds page P to the pages that map the shared frame of zeros,
+   and returns that frame.  The frame must only be mapped
+   read-only. */
+struct frame *
+frame_share_zero (struct page *p)
+{
+  frame_attach (&zero_frame, p);
+  return &zero_frame;
+}
+
+/* Returns true if F is the shared frame of zeros. */
+bool
+frame_is_zero (const struct frame *f)
+{
+  return f == &zero_frame;
+}
+
+/* Allows frame F to be evicted. */
+void
+frame_unpin (struct frame *f)
+{
+  ASSERT (f->pinned);
+
+  lock_acquire (&frame_lock);
+  f->pinned = false;
+  if (f->inode != NULL)
+    cond_broadcast (&cache_cond, &frame_lock);
+  lock_release (&frame_lock);
+}
+
+/* Adds page P to the pages that share frame F.  The caller must
+   hold the lock of P and of a page already in F, unless F is
+   pinned. */
+void
+frame_attach (struct frame *f, struct page *p)
+{
+  lock_acquire (&frame_lock);
+  list_push_back (&f->pages, &p->frame_elem);
+  charge (f, p, 1);
+  lock_release (&frame_lock);
+}
+
+/* Returns the number of pages that share frame F.  The caller
+   must hold the lock of one of them. */
+size_t
+frame_ref_cnt (struct frame *f)
+{
+  size_t cnt;
+
+  lock_acquire (&frame_lock);
+  cnt = list_size (&f->pages);
+  lock_release (&frame_lock);
+  return cnt;
+}
+
+/* Removes page P, which the caller has already unmapped, from
+   the pages that share frame F.  If P was the last one, frees
+   F.  The caller must hold P's lock and, for a page cache
+   frame, must already have written P back to the file if it
+   was modified. */
+void
+frame_release (struct frame *f, struct page *p)
+{
+  bool last;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  lock_acquire (&frame_lock);
+  list_remove (&p->frame_elem);
+  charge (f, p, -1);
+  last = list_empty (&f->pages) && !f->pinned;
+  if (last)
+    remove_frame (f);
+  lock_release (&frame_lock);
+
+  if (last)
+    {
+      inode_close (f->inode);
+      palloc_free_page (f->kpage);
+      free (f);
+    }
+}
+
+/* Removes frame F from the frame table and the page cache and
+   returns it to the user pool, taking it off the resident sets
+   of the pages still listed in it.  The caller must already have
+   unmapped it. */
+void
+frame_free (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  while (!list_empty (&f->pages))
+    {
+      struct list_elem *e = list_pop_front (&f->pages);
+      charge (f, list_entry (e, struct page, frame_elem), -1);
+    }
+  remove_frame (f);
+  lock_release (&frame_lock);
+
+  inode_close (f->inode);
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Removes frame F from the frame table and from the page cache,
+   waking up anyone waiting for it.  The caller must hold
+   FRAME_LOCK. */
+static void
+remove_frame (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+  frame_cnt--;
+  if (f->inode != NULL)
+    {
+      hash_delete (&cache, &f->cache_elem);
+      cond_broadcast (&cache_cond, &frame_lock);
+    }
+}
+
+/* Removes frame F, which must be pinned, from the page cache
+   without freeing it, so that it can be reused for other data. */
+static void
+uncache_frame (struct frame *f)
+{
+  struct inode *inode = f->inode;
+
+  ASSERT (f->pinned);
+
+  lock_acquire (&frame_lock);
+  hash_delete (&cache, &f->cache_elem);
+  cond_broadcast (&cache_cond, &frame_lock);
+  f->inode = NULL;
+  lock_release (&frame_lock);
+
+  inode_close (inode);
+}
+
+/* Tries to acquire the lock of every page mapped to F, without
+   blocking.  Returns true if successful.  On failure, holds none
+   of the locks.  Fails if the current thread already holds one
+   of them, since it is working on that page. */
+static bool
+lock_pages (struct frame *f)
+{
+  struct list_elem *e, *f_end;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      if (lock_held_by_current_thread (&p->lock)
+          || !lock_try_acquire (&p->lock))
+        {
+          f_end = e;
+          for (e = list_begin (&f->pages); e != f_end; e = list_next (e))
+            lock_release (&list_entry (e, struct page, frame_elem)->lock);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Releases the locks of every page mapped to F. */
+static void
+unlock_pages (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    lock_release (&list_entry (e, struct page, frame_elem)->lock);
+}
+
+/* Returns true if any page mapped to F has been accessed, and
+   clears their accessed bits and REFERENCED flags. */
+static bool
+test_and_clear_accessed (struct frame *f)
+{
+  bool accessed = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+      if (p->referenced)
+        {
+          p->referenced = false;
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Adds DELTA to the resident set size of the owner of page P,
+   which is joining or leaving frame F. */
+static void
+charge (struct frame *f, struct page *p, int delta)
+{
+  enum intr_level old_level;
+
+  if (f == &zero_frame)
+    return;
+  old_level = intr_disable ();
+  p->owner->rss += delta;
+  intr_set_level (old_level);
+}
+
+/* Returns true if thread T must give up a resident page before
+   it can have another. */
+static bool
+at_hard_limit (const struct thread *t)
+{
+  return t->rss_hard_limit != 0 && t->rss >= t->rss_hard_limit;
+}
+
+/* Starts a working set sample of thread T. */
+static void
+start_sample (struct thread *t, void *aux UNUSED)
+{
+  t->ws_cnt = 0;
+}
+
+/* Finishes a working set sample of thread T, averaging it with
+   the previous estimate. */
+static void
+finish_sample (struct thread *t, void *aux UNUSED)
+{
+  t->wss = (t->wss + t->ws_cnt + 1) / 2;
+}
+
+/* Estimates every process's working set, if WS_SAMPLE_TICKS have
+   passed since the last estimate, by counting the resident pages
+   it has accessed since then.  The caller must hold
+   FRAME_LOCK. */
+static void
+sample_working_sets (void)
+{
+  static int64_t sample_ticks;
+  enum intr_level old_level;
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (timer_elapsed (sample_ticks) < WS_SAMPLE_TICKS)
+    return;
+  sample_ticks = timer_ticks ();
+
+  old_level = intr_disable ();
+  thread_foreach (start_sample, NULL);
+  intr_set_level (old_level);
+
+  for (e = list_begin (&frames); e != list_end (&frames); e = list_next (e))
+    {
+      struct frame *f = list_entry (e, struct frame, elem);
+      struct list_elem *pe;
+
+      if (f->pinned || !lock_pages (f))
+        continue;
+      for (pe = list_begin (&f->pages); pe != list_end (&f->pages);
+           pe = list_next (pe))
+        {
+          struct page *p = list_entry (pe, struct page, frame_elem);
+          uint32_t *pd = p->owner->pagedir;
+
+          if (pagedir_is_accessed (pd, p->upage))
+            {
+              pagedir_set_accessed (pd, p->upage, false);
+              p->referenced = true;
+              p->owner->ws_cnt++;
+            }
+        }
+      unlock_pages (f);
+    }
+
+  old_level = intr_disable ();
+  thread_foreach (finish_sample, NULL);
+  intr_set_level (old_level);
+}
+
+/* Returns true if every page mapped to F belongs to a process
+   that is a good source of victims of class C.  For class OWNED,
+   that means process T. */
+static bool
+in_victim_class (struct frame *f, enum victim_class c, struct thread *t)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct thread *owner = list_entry (e, struct page, frame_elem)->owner;
+      bool ok;
+
+      switch (c)
+        {
+        case OWNED:
+          ok = owner == t;
+          break;
+        case OVER_SOFT_LIMIT:
+          ok = (owner->rss_soft_limit != 0
+                && owner->rss > owner->rss_soft_limit);
+          break;
+        case OVER_WORKING_SET:
+          ok = owner->rss > owner->wss;
+          break;
+        default:
+          ok = true;
+          break;
+        }
+      if (!ok)
+        return false;
+    }
+  return true;
+}
+
+/* Advances the clock hand and returns the frame it passes. */
+static struct frame *
+clock_advance (void)
+{
+  struct frame *f;
+
+  if (hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Chooses up to SWAP_CLUSTER frames of class C, owned by T if C
+   is OWNED, with the clock algorithm, pins them, and stores them
+   in VICTIMS with the locks of all their pages held.  Returns
+   the number of frames chosen.  The caller must hold
+   FRAME_LOCK. */
+static size_t
+choose_victims (struct frame *victims[], enum victim_class c,
+                struct thread *t)
+{
+  size_t victim_cnt = 0;
+  size_t scan_cnt = 0;
+  size_t i;
+
+  for (i = 0; i < 2 * frame_cnt + 1 && frame_cnt > 0; i++)
+    {
+      struct frame *f = clock_advance ();
+
+      /* Once we have a victim, look only a little further for
+         more pages to write out with it. */
+      if (victim_cnt > 0 && ++scan_cnt > 2 * SWAP_CLUSTER)
+        break;
+
+      /* Skip pinned frames, frames of processes that we are not
+         taking pages from, and pages that their owners are
+         working on right now. */
+      if (f->pinned || !in_victim_class (f, c, t) || !lock_pages (f))
+        continue;
+
+      /* Give recently accessed pages a second chance. */
+      if (test_and_clear_accessed (f))
+        {
+          unlock_pages (f);
+          continue;
+        }
+
+      /* Only pages that must be written to swap are worth taking
+         along with the first victim. */
+      if (victim_cnt > 0
+          && (f->inode != NULL
+              || !pagedir_is_dirty (frame_page (f)->owner->pagedir,
+                                    frame_page (f)->upage)))
+        {
+          unlock_pages (f);
+          continue;
+        }
+
+      f->pinned = true;
+      victims[victim_cnt++] = f;
+      if (victim_cnt == SWAP_CLUSTER)
+        break;
+    }
+  return victim_cnt;
+}
+
+/* Chooses frames with the clock algorithm, writes their pages
+   out, and returns one of the now-empty frames, pinned.  If T is
+   non-null, chooses only frames that belong to T alone;
+   otherwise, prefers frames of processes that have more pages
+   resident than they should.
+   Returns a null pointer if every candidate frame is pinned or
+   none of their pages can be written out. */
+static struct frame *
+evict (struct thread *t)
+{
+  struct frame *victims[SWAP_CLUSTER];
+  struct frame *result = NULL;
+  size_t victim_cnt = 0;
+  size_t i;
+
+  lock_acquire (&frame_lock);
+  sample_working_sets ();
+  if (t != NULL)
+    victim_cnt = choose_victims (victims, OWNED, t);
+  else
+    {
+      enum victim_class c;
+
+      for (c = OVER_SOFT_LIMIT; c <= ANY_FRAME && victim_cnt == 0; c++)
+        victim_cnt = choose_victims (victims, c, NULL);
+    }
+  lock_release (&frame_lock);
+
+  /* Evict the pages without holding the frame table lock, since
+     writing them out can take a long time. */
+  page_out (victims, victim_cnt);
+  for (i = 0; i < victim_cnt; i++)
+    {
+      struct frame *f = victims[i];
+      struct list_elem *e = list_begin (&f->pages);
+      bool evicted;
+
+      /* Detach the pages that page_out() evicted and release the
+         page locks that choose_victims() took.  Once a page's lock
+         is released, its owner may free it and take it off the
+         list with frame_release(), so walk the list under
+         FRAME_LOCK, as frame_release() does. */
+      lock_acquire (&frame_lock);
+      while (e != list_end (&f->pages))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+
+          e = list_next (e);
+          if (p->frame == NULL)
+            {
+              list_remove (&p->frame_elem);
+              charge (f, p, -1);
+            }
+          lock_release (&p->lock);
+        }
+      evicted = list_empty (&f->pages);
+      lock_release (&frame_lock);
+      if (evicted && f->inode != NULL)
+        uncache_frame (f);
+
+      if (!evicted)
+        frame_unpin (f);
+      else if (result == NULL)
+        result = f;
+      else
+        frame_free (f);
+    }
+  return result;
+}
+
+/* Returns a hash value for the page cache frame that E refers
+   to. */
+static unsigned
+cache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, cache_elem);
+  return (hash_bytes (&f->inode, sizeof f->inode)
+          ^ hash_int (f->ofs) ^ hash_int (f->length));
+}
+
+/* Returns true if page cache frame A precedes page cache frame
+   B. */
+static bool
+cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, cache_elem);
+  const struct frame *b = hash_entry (b_, struct frame, cache_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  else if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  else
+    return a->length < b->length;
+}
@@ -0,0 +1,58 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/page.h"
+
+struct inode;
+
+/* A physical frame in the user pool. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages mapped to the frame. */
+    bool pinned;                /* Never evicted while true. */
+    struct list_elem elem;      /* Element in frame table. */
+
+    /* Page cache.  INODE is null unless the frame caches part of
+       a file, in which case it holds the LENGTH bytes at offset
+       OFS in INODE followed by zeros, and every page in PAGES is
+       a mapping of that part of the file. */
+    struct inode *inode;        /* Cached inode, or null. */
+    off_t ofs;                  /* Page-aligned offset in INODE. */
+    size_t length;              /* Number of bytes from INODE. */
+    struct hash_elem cache_elem; /* Element in page cache. */
+  };
+
+/* Default resident set limits of new processes, in pages, or 0
+   for no limit. */
+extern size_t rss_soft_limit_default;
+extern size_t rss_hard_limit_default;
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *);
+struct frame *frame_try_alloc (struct page *);
+struct frame *frame_share (struct page *, struct inode *, off_t ofs,
+                           size_t length, bool *fill);
+struct frame *frame_try_share (struct page *, struct inode *, off_t ofs,
+                               size_t length, bool *fill);
+struct frame *frame_share_zero (struct page *);
+bool frame_is_zero (const struct frame *);
+void frame_unpin (struct frame *);
+void frame_attach (struct frame *, struct page *);
+size_t frame_ref_cnt (struct frame *);
+void frame_release (struct frame *, struct page *);
+void frame_free (struct frame *);
+
+/* Returns the first page in F. */
+static inline struct page *
+frame_page (struct frame *f)
+{
+  return list_entry (list_front (&f->pages), struct page, frame_elem);
+}
+
+#endif /* vm/frame.h */
@@ -0,0 +1,136 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   Each mapping covers the pages from its start address up to
+   and including the one that contains the last byte of its file.
+   The pages are entered in the supplemental page table as
+   mappings of a private reopened copy of the file, so that
+   closing the file descriptor that the mapping was made from
+   does not affect it.  The pages themselves are loaded on demand
+   through the page cache; see page.c. */
+
+/* A memory mapping. */
+struct mapping
+  {
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* Mapped file. */
+    uint8_t *addr;              /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+    struct list_elem elem;      /* Element in thread's `mappings' list. */
+  };
+
+static void unmap (struct mapping *);
+
+/* Maps FILE into the current process's address space at ADDR.
+   Returns the new mapping's identifier, or MAP_FAILED if ADDR is
+   null or not page-aligned, if FILE is empty, if the range would
+   overlap pages that are already in use or the region reserved
+   for the stack, or on memory allocation failure. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+  length = file_length (file);
+  if (length <= 0 || (uintptr_t) addr + length < (uintptr_t) addr)
+    return MAP_FAILED;
+
+  /* Leave room for the stack to grow, and a guard gap below it. */
+  if ((uintptr_t) addr + length
+      > (uintptr_t) PHYS_BASE - stack_limit - STACK_GUARD_PAGES * PGSIZE)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  m->addr = addr;
+  m->page_cnt = 0;
+
+  for (i = 0; (off_t) (i * PGSIZE) < length; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_shared (m->addr + ofs, m->file, ofs, read_bytes, true))
+        {
+          unmap (m);
+          return MAP_FAILED;
+        }
+      m->page_cnt++;
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Unmaps the current process's mapping ID, writing modified
+   pages back to the file.  Returns true if successful, false if
+   there is no such mapping. */
+bool
+mmap_unmap (mapid_t id)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        {
+          list_remove (&m->elem);
+          unmap (m);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Unmaps all of the current process's mappings.  Must be called
+   before the process's supplemental page table is destroyed. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_pop_front (mappings), struct mapping, elem));
+}
+
+/* Removes M's pages, closes its file, and frees M. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  /* Unmap the whole range with one TLB invalidation.  The pages'
+     dirty bits stay behind for page_remove() to check. */
+  if (m->page_cnt > 0)
+    pagedir_clear_range (thread_current ()->pagedir, m->addr, m->page_cnt);
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (m->addr + i * PGSIZE);
+  file_close (m->file);
+  free (m);
+}
@@ -0,0 +1,16 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <stdbool.h>
+
+struct file;
+
+/* Identifies a memory mapping. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+mapid_t mmap_map (struct file *, void *addr);
+bool mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
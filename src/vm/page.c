@@ -0,0 +1,857 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Instead of reading every page of an executable into memory
+   when it is loaded, load() records where each page's contents
+   come from in the process's supplemental page table, a hash
+   table keyed by user virtual page.  The first access to a page
+   faults, and page_fault() calls page_load() to obtain a frame,
+   fill it from the recorded source, and map it.
+
+   When the frame table evicts pages, page_out() unmaps them and
+   writes the modified ones to swap together.  Unmodified pages
+   are simply dropped, because they can be read again from their
+   file, from swap, or zero-filled.  A page read back from swap
+   keeps its slot until it is modified, so that a clean page can
+   be dropped again without another write.  Pages of the same
+   process that were swapped out next to it are read back in the
+   same run.
+
+   Pages of zeros that have only been read all map a single
+   read-only frame of zeros, so that a large BSS or stack costs
+   no memory until it is written.
+
+   After fork(), parent and child share their resident pages'
+   frames, and their swap slots, until one of them writes to a
+   page; see page_copy_on_write().
+
+   Pages of memory-mapped files are different: they are loaded
+   through the page cache, shared with every other mapping of
+   the same part of the file, and written back to the file
+   instead of to swap, and only if they were modified.  The
+   read-only segments of executables are loaded the same way, so
+   that every process running a program shares one copy of its
+   code.
+
+   A fault on a mapped page also maps the other pages of the same
+   file in the aligned window of fault_around_pages pages around
+   it that are already in the page cache, and reads in the ones
+   after it that are not, if there are free frames to hold them.
+   A program that reads a file or runs its code sequentially thus
+   takes one fault per window instead of one per page. */
+
+/* Maximum size of a user stack, in bytes.  Set with the -sl
+   kernel command-line option. */
+size_t stack_limit = STACK_LIMIT_DEFAULT;
+
+/* Number of pages in the fault-around window.  Set with the -fa
+   kernel command-line option; 0 or 1 disables fault-around. */
+size_t fault_around_pages = FAULT_AROUND_DEFAULT;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static struct page *page_create (void *upage, bool writable);
+static void page_free (struct page *);
+static bool page_swap_in (struct page *, struct frame *);
+static bool page_map_shared (struct page *, bool may_evict);
+static bool page_map_cached (struct page *);
+static void fault_around (struct page *);
+static bool map_frame (struct page *, struct frame *);
+
+/* Initializes the current thread's supplemental page table and
+   gives it the default resident set limits.  Returns true if
+   successful, false on memory allocation failure. */
+bool
+page_table_init (void)
+{
+  struct thread *t = thread_current ();
+
+  t->rss_soft_limit = rss_soft_limit_default;
+  t->rss_hard_limit = rss_hard_limit_default;
+  return hash_init (&t->pages, page_hash, page_less, NULL);
+}
+
+/* Destroys the current thread's supplemental page table, freeing
+   the frames and swap slots that its pages occupy.  Must be
+   called before the thread's page directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  hash_destroy (&thread_current ()->pages, page_destroy);
+}
+
+/* Returns the current thread's page that contains UADDR, or a
+   null pointer if there is no such page. */
+struct page *
+page_lookup (const void *uaddr)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (&thread_current ()->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Adds page UPAGE to the current thread's supplemental page
+   table, to be loaded on first access by reading READ_BYTES
+   bytes from FILE starting at offset OFS and zeroing the rest.
+   FILE must stay open until the page table is destroyed.
+   Returns true if successful, false if UPAGE is already present
+   or on memory allocation failure. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = page_create (upage, writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Adds page UPAGE to the current thread's supplemental page
+   table, to be zero-filled on first access.
+   Returns true if successful, false if UPAGE is already present
+   or on memory allocation failure. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_create (upage, writable) != NULL;
+}
+
+/* Adds page UPAGE to the current thread's supplemental page
+   table as a mapping of the READ_BYTES bytes at offset OFS in
+   FILE, followed by zeros, shared through the page cache with
+   every other such mapping.  OFS must be page-aligned.  FILE
+   must stay open until the page is removed.
+   Returns true if successful, false if UPAGE is already present
+   or on memory allocation failure. */
+bool
+page_add_shared (void *upage, struct file *file, off_t ofs,
+                 size_t read_bytes, bool writable)
+{
+  ASSERT (ofs % PGSIZE == 0);
+
+  if (!page_add_file (upage, file, ofs, read_bytes, writable))
+    return false;
+  page_lookup (upage)->shared = true;
+  return true;
+}
+
+/* Maps the current thread's shared page UPAGE right away if its
+   contents are already in the page cache, sparing the process a
+   page fault on first access.  Does nothing otherwise. */
+void
+page_prefault (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL && p->shared);
+
+  lock_acquire (&p->lock);
+  if (p->frame == NULL)
+    page_map_cached (p);
+  lock_release (&p->lock);
+}
+
+/* Removes page UPAGE from the current thread's supplemental page
+   table and frees it.  If it is a modified mapping of a file,
+   writes it back first. */
+void
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (&thread_current ()->pages, &p->hash_elem);
+  page_free (p);
+}
+
+/* Brings in the current thread's page that contains FAULT_ADDR
+   and maps it into the page directory.  WRITE indicates whether
+   the page is about to be written; a page of zeros that is only
+   being read is mapped to the shared frame of zeros instead of a
+   frame of its own.
+   Returns true if successful, false if FAULT_ADDR is not part of
+   the address space or if memory allocation or file reading
+   fails. */
+bool
+page_load (const void *fault_addr, bool write)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+  struct frame *f;
+  uint8_t *kpage;
+
+  if (t->pagedir == NULL)
+    return false;
+  p = page_lookup (fault_addr);
+  if (p == NULL)
+    return false;
+
+  lock_acquire (&p->lock);
+  if (p->frame != NULL)
+    {
+      /* Either someone else loaded the page while we waited for
+         its lock, or it is shared with the process we were forked
+         from and has not yet been entered in our page
+         directory. */
+      bool success = (pagedir_get_page (t->pagedir, p->upage) != NULL
+                      || map_frame (p, p->frame));
+      lock_release (&p->lock);
+      return success;
+    }
+  if (p->shared)
+    {
+      bool success = page_map_shared (p, true);
+      lock_release (&p->lock);
+      if (success)
+        fault_around (p);
+      return success;
+    }
+  if (p->file == NULL && p->swap_slot == SWAP_NONE && !write)
+    {
+      /* Share the frame of zeros until the first write, which
+         gets a private frame from page_copy_on_write(). */
+      bool success;
+
+      f = frame_share_zero (p);
+      success = map_frame (p, f);
+      if (success)
+        p->frame = f;
+      else
+        frame_release (f, p);
+      lock_release (&p->lock);
+      return success;
+    }
+
+  f = frame_alloc (p);
+  if (f == NULL)
+    goto fail;
+  kpage = f->kpage;
+
+  if (p->swap_slot != SWAP_NONE)
+    {
+      if (!page_swap_in (p, f))
+        goto fail;
+      lock_release (&p->lock);
+      frame_unpin (f);
+      return true;
+    }
+
+  if (p->file != NULL
+      && file_read_at (p->file, kpage, p->read_bytes, p->file_ofs)
+         != (off_t) p->read_bytes)
+    goto fail;
+  memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+
+  if (!pagedir_set_page (t->pagedir, p->upage, kpage, p->writable))
+    goto fail;
+  p->frame = f;
+  lock_release (&p->lock);
+  frame_unpin (f);
+  return true;
+
+ fail:
+  if (f != NULL)
+    frame_free (f);
+  lock_release (&p->lock);
+  return false;
+}
+
+/* Enters frame F, which already holds page P's contents, in the
+   page directory of P's owner.  A writable page is mapped
+   read-only if it shares F copy-on-write with other pages or if
+   F is the frame of zeros.
+   Returns true if successful, false on memory allocation
+   failure. */
+static bool
+map_frame (struct page *p, struct frame *f)
+{
+  bool writable = (p->writable && !frame_is_zero (f)
+                   && (p->shared || frame_ref_cnt (f) == 1));
+  return pagedir_set_page (p->owner->pagedir, p->upage, f->kpage, writable);
+}
+
+/* Handles a write fault on the current thread's page that
+   contains FAULT_ADDR, which is mapped read-only because it
+   shares its frame copy-on-write or maps the frame of zeros.
+   Gives the page a private copy of the frame or, if no other
+   page shares it any more, just makes it writable.
+   Returns true if successful, false if the page is not writable
+   or on memory allocation failure. */
+bool
+page_copy_on_write (const void *fault_addr)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct page *p;
+  struct frame *f;
+  bool success = true;
+  bool dirty;
+
+  if (pd == NULL)
+    return false;
+  p = page_lookup (fault_addr);
+  if (p == NULL || !p->writable || p->shared)
+    return false;
+
+  lock_acquire (&p->lock);
+  f = p->frame;
+  if (f == NULL || pagedir_get_page (pd, p->upage) == NULL)
+    {
+      /* Evicted while we waited for the lock.  Retrying the
+         write will bring the page back in. */
+      lock_release (&p->lock);
+      return true;
+    }
+
+  dirty = pagedir_is_dirty (pd, p->upage) || p->dirty;
+  pagedir_clear_page (pd, p->upage);
+  if (frame_is_zero (f) || frame_ref_cnt (f) > 1)
+    {
+      struct frame *copy = frame_alloc (NULL);
+
+      if (copy != NULL)
+        {
+          if (frame_is_zero (f))
+            memset (copy->kpage, 0, PGSIZE);
+          else
+            memcpy (copy->kpage, f->kpage, PGSIZE);
+          frame_release (f, p);
+          frame_attach (copy, p);
+          p->frame = f = copy;
+          frame_unpin (copy);
+        }
+      else
+        success = false;
+    }
+  if (!pagedir_set_page (pd, p->upage, f->kpage, success))
+    success = false;
+  pagedir_set_dirty (pd, p->upage, dirty);
+  p->dirty = false;
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Copies PARENT's supplemental page table into the current
+   thread's, which must be empty, for fork().  Pages in memory
+   share their frames copy-on-write: PARENT's writable pages are
+   made read-only, and the first write to a shared frame from
+   either process gets that process a private copy.  The current
+   thread's page directory entries are created lazily, by
+   page_load(), when it first touches each page.  Pages in swap
+   share their swap slots.  Mappings of files are not copied.
+   The resident set limits are inherited.
+   PARENT must not be running, and the current thread's
+   `exec_file' must already refer to PARENT's executable.
+   Returns true if successful, false on memory allocation
+   failure. */
+bool
+page_table_copy (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  t->stack_bottom = parent->stack_bottom;
+  t->rss_soft_limit = parent->rss_soft_limit;
+  t->rss_hard_limit = parent->rss_hard_limit;
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *p;
+
+      if (pp->file != NULL && pp->file != parent->exec_file)
+        continue;
+      p = page_create (pp->upage, pp->writable);
+      if (p == NULL)
+        return false;
+      p->file = pp->file != NULL ? t->exec_file : NULL;
+      p->file_ofs = pp->file_ofs;
+      p->read_bytes = pp->read_bytes;
+      p->shared = pp->shared;
+
+      lock_acquire (&pp->lock);
+      if (pp->swap_slot != SWAP_NONE)
+        {
+          swap_dup (pp->swap_slot);
+          p->swap_slot = pp->swap_slot;
+        }
+      if (pp->frame != NULL)
+        {
+          /* The frame may hold changes that only PARENT's page
+             directory knows about. */
+          p->dirty = (pagedir_is_dirty (parent->pagedir, pp->upage)
+                      || pp->dirty);
+          if (pp->writable)
+            pagedir_set_writable (parent->pagedir, pp->upage, false);
+          p->frame = pp->frame;
+          frame_attach (pp->frame, p);
+        }
+      lock_release (&pp->lock);
+    }
+  return true;
+}
+
+/* Maps shared page P to its frame in the page cache, reading it
+   from P's file first if it is not already cached.  A frame to
+   read it into is made by evicting a page only if MAY_EVICT is
+   true.  The caller must hold P's lock.  Returns true if
+   successful, false on failure. */
+static bool
+page_map_shared (struct page *p, bool may_evict)
+{
+  struct inode *inode = file_get_inode (p->file);
+  struct frame *f;
+  bool fill;
+
+  f = (may_evict
+       ? frame_share (p, inode, p->file_ofs, p->read_bytes, &fill)
+       : frame_try_share (p, inode, p->file_ofs, p->read_bytes, &fill));
+  if (f == NULL)
+    return false;
+  if (fill)
+    {
+      off_t n = file_read_at (p->file, f->kpage, p->read_bytes, p->file_ofs);
+      if (n < 0)
+        n = 0;
+      memset ((uint8_t *) f->kpage + n, 0, PGSIZE - n);
+      frame_unpin (f);
+    }
+
+  if (!map_frame (p, f))
+    {
+      frame_release (f, p);
+      return false;
+    }
+  p->frame = f;
+  return true;
+}
+
+/* Maps shared page P to its frame in the page cache if it is
+   already cached and not being read in or written out.  Never
+   blocks.  The caller must hold P's lock.  Returns true if
+   successful, false if P is not cached or on failure. */
+static bool
+page_map_cached (struct page *p)
+{
+  struct frame *f;
+
+  f = frame_try_share (p, file_get_inode (p->file), p->file_ofs,
+                       p->read_bytes, NULL);
+  if (f == NULL)
+    return false;
+  if (!map_frame (p, f))
+    {
+      frame_release (f, p);
+      return false;
+    }
+  p->frame = f;
+  return true;
+}
+
+/* Maps the current thread's pages of the same file as shared page
+   P, which was just faulted in, that lie in the aligned window of
+   fault_around_pages pages around P.  Pages before P are mapped
+   only if they are resident.  Pages after P are read ahead if
+   they are not, until no free frame is left; fault-around never
+   evicts or waits.  Pages that someone else is busy with, and
+   pages whose frames are being read in or written out, are
+   skipped. */
+static void
+fault_around (struct page *p)
+{
+  struct thread *t = thread_current ();
+  size_t window = fault_around_pages;
+  uint8_t *start;
+  bool read_ahead = true;
+  size_t i;
+
+  if (window <= 1)
+    return;
+
+  start = (uint8_t *) p->upage - pg_no (p->upage) % window * PGSIZE;
+  for (i = 0; i < window; i++)
+    {
+      uint8_t *upage = start + i * PGSIZE;
+      struct page *q;
+
+      if (upage == p->upage || !is_user_vaddr (upage))
+        continue;
+      q = page_lookup (upage);
+      if (q == NULL || !q->shared || q->file != p->file
+          || !lock_try_acquire (&q->lock))
+        continue;
+
+      if (q->frame != NULL)
+        {
+          /* Resident, but not yet in our page directory after
+             fork(). */
+          if (pagedir_get_page (t->pagedir, q->upage) == NULL)
+            map_frame (q, q->frame);
+        }
+      else if (upage < (uint8_t *) p->upage || !read_ahead)
+        page_map_cached (q);
+      else if (!page_map_shared (q, false))
+        read_ahead = false;
+      lock_release (&q->lock);
+    }
+}
+
+/* Grows the current thread's stack down to the page containing
+   FAULT_ADDR, if the fault looks like a stack access given user
+   stack pointer ESP: it must be no more than 32 bytes below
+   ESP, because PUSHA checks access to all of the 32 bytes it is
+   about to push before it moves ESP, and within STACK_LIMIT of
+   the top of the stack.  The stack must also stay at least
+   STACK_GUARD_PAGES away from any other page, so that it never
+   silently runs into the heap or a mapping.
+
+   A fault more than a page below the current bottom of the
+   stack usually means that a large stack frame is being set up,
+   whose pages are about to be touched one after another, so up
+   to STACK_PREFAULT of them are brought in at once.
+   Returns true if successful, false if FAULT_ADDR is not a
+   valid stack access or on failure. */
+bool
+page_grow_stack (const void *fault_addr, const void *esp)
+{
+  struct thread *t = thread_current ();
+  uint8_t *floor = (uint8_t *) PHYS_BASE - stack_limit;
+  uint8_t *upage = pg_round_down (fault_addr);
+  uint8_t *bottom = t->stack_bottom;
+  uint8_t *p;
+  size_t cnt, i;
+
+  if (t->pagedir == NULL || bottom == NULL
+      || (const uint8_t *) fault_addr < (const uint8_t *) esp - 32
+      || upage < floor || upage >= bottom)
+    return false;
+
+  /* Check that neither the new stack pages nor the guard gap
+     below them overlap other pages. */
+  for (p = upage - STACK_GUARD_PAGES * PGSIZE; p < bottom; p += PGSIZE)
+    if (page_lookup (p) != NULL)
+      return false;
+
+  /* The process may touch any page between the fault and the
+     old bottom of the stack from now on, since they are all above
+     ESP.  Add them from the top down, so that if memory runs out
+     partway the stack still ends at its lowest page. */
+  for (p = bottom; p > upage; p -= PGSIZE)
+    if (!page_add_zero (p - PGSIZE, true))
+      {
+        t->stack_bottom = p;
+        return false;
+      }
+  t->stack_bottom = upage;
+
+  cnt = (bottom - upage) / PGSIZE;
+  if (cnt > STACK_PREFAULT)
+    cnt = STACK_PREFAULT;
+  for (i = 0; i < cnt; i++)
+    if (!page_load (upage + i * PGSIZE, true))
+      return i > 0;
+  return true;
+}
+
+/* Reads page P, which must be in swap, into frame F along with
+   up to SWAP_READAHEAD - 1 pages of the current process that
+   occupy the following swap slots, for which free frames are
+   available, and maps them all.  The caller must hold P's lock.
+   Returns true if successful, false if P could not be mapped. */
+static bool
+page_swap_in (struct page *p, struct frame *f)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct frame *frames[SWAP_READAHEAD];
+  void *kpages[SWAP_READAHEAD];
+  size_t slot = p->swap_slot;
+  size_t cnt, i;
+
+  frames[0] = f;
+  kpages[0] = f->kpage;
+  for (cnt = 1; cnt < SWAP_READAHEAD; cnt++)
+    {
+      struct page *q = swap_get_page (slot + cnt, thread_current ());
+      if (q == NULL || !lock_try_acquire (&q->lock))
+        break;
+      if (q->frame != NULL || q->swap_slot != slot + cnt
+          || (frames[cnt] = frame_try_alloc (q)) == NULL)
+        {
+          lock_release (&q->lock);
+          break;
+        }
+      kpages[cnt] = frames[cnt]->kpage;
+    }
+
+  swap_in (slot, kpages, cnt);
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *q = frame_page (frames[i]);
+      bool mapped = pagedir_set_page (pd, q->upage, kpages[i], q->writable);
+
+      if (mapped)
+        {
+          q->frame = frames[i];
+
+          /* Don't let a resident page take up room in the pool of
+             compressed pages.  With its slot gone, the page must
+             go back to swap when it is next evicted. */
+          if (swap_reclaim (q->swap_slot))
+            {
+              q->swap_slot = SWAP_NONE;
+              pagedir_set_dirty (pd, q->upage, true);
+            }
+        }
+      if (i > 0)
+        {
+          /* Leave the accessed bit clear on pages that were read
+             ahead, so that they are evicted first if unused. */
+          if (mapped)
+            frame_unpin (frames[i]);
+          else
+            frame_free (frames[i]);
+          lock_release (&q->lock);
+        }
+      else if (!mapped)
+        return false;
+    }
+  return true;
+}
+
+/* Unmaps every page in page cache frame F and, if any of them
+   was modified, writes F back to its file.  The caller must hold
+   the lock of every page in F. */
+static void
+write_back (struct frame *f)
+{
+  bool dirty = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      ASSERT (lock_held_by_current_thread (&p->lock));
+      pagedir_clear_page (pd, p->upage);
+      if (pagedir_is_dirty (pd, p->upage))
+        dirty = true;
+      p->frame = NULL;
+    }
+  if (dirty)
+    inode_write_at (f->inode, f->kpage, f->length, f->ofs);
+}
+
+/* Unmaps the pages in the CNT pinned frames in FRAMES from their
+   owners' address spaces and writes the modified ones to swap,
+   or back to their files for page cache frames, leaving those
+   frames empty.  The caller must hold the lock of every page in
+   each frame.  If swap is full, some modified pages stay mapped;
+   their `frame' member is still non-null when this function
+   returns. */
+void
+page_out (struct frame *frames[], size_t cnt)
+{
+  void *kpages[SWAP_CLUSTER];
+  struct page *pages[SWAP_CLUSTER];
+  struct frame *dirty[SWAP_CLUSTER];
+  size_t slots[SWAP_CLUSTER];
+  size_t dirty_cnt = 0;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct frame *f = frames[i];
+      struct page *first_dirty = NULL;
+      struct list_elem *e;
+
+      ASSERT (f->pinned);
+      if (f->inode != NULL)
+        {
+          write_back (f);
+          continue;
+        }
+
+      /* A frame shared copy-on-write has several pages.  Those
+         that differ from their own backing store all go to the
+         same swap slot. */
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          uint32_t *pd = p->owner->pagedir;
+
+          ASSERT (lock_held_by_current_thread (&p->lock));
+          ASSERT (p->frame == f);
+
+          /* Unmap first, so that the owner faults, and waits for
+             us, if it touches the page while we are writing it
+             out. */
+          pagedir_clear_page (pd, p->upage);
+          if (pagedir_is_dirty (pd, p->upage) || p->dirty)
+            {
+              /* Any copy already in swap is out of date. */
+              if (p->swap_slot != SWAP_NONE)
+                {
+                  swap_free (p->swap_slot);
+                  p->swap_slot = SWAP_NONE;
+                }
+              if (first_dirty == NULL)
+                first_dirty = p;
+            }
+          else
+            p->frame = NULL;
+        }
+      if (first_dirty != NULL)
+        {
+          kpages[dirty_cnt] = f->kpage;
+          pages[dirty_cnt] = first_dirty;
+          dirty[dirty_cnt++] = f;
+        }
+    }
+
+  swap_out (kpages, pages, dirty_cnt, slots);
+  for (i = 0; i < dirty_cnt; i++)
+    {
+      struct frame *f = dirty[i];
+      bool shared = list_begin (&f->pages) != list_rbegin (&f->pages);
+      struct list_elem *e;
+
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          uint32_t *pd = p->owner->pagedir;
+
+          if (p->frame == NULL)
+            continue;
+          if (slots[i] != SWAP_NONE)
+            {
+              if (p != pages[i])
+                swap_dup (slots[i]);
+              p->swap_slot = slots[i];
+              p->frame = NULL;
+              p->dirty = false;
+            }
+          else
+            {
+              pagedir_set_page (pd, p->upage, f->kpage,
+                                p->writable && !shared);
+              pagedir_set_dirty (pd, p->upage, true);
+            }
+        }
+    }
+}
+
+/* Creates a page for UPAGE with no backing file and inserts it
+   into the current thread's supplemental page table.
+   Returns the new page, or a null pointer if UPAGE is already
+   present or on memory allocation failure. */
+static struct page *
+page_create (void *upage, bool writable)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->upage = upage;
+  p->owner = thread_current ();
+  p->writable = writable;
+  lock_init (&p->lock);
+  p->frame = NULL;
+  p->swap_slot = SWAP_NONE;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->read_bytes = 0;
+  p->shared = false;
+  p->dirty = false;
+  p->referenced = false;
+  if (hash_insert (&thread_current ()->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Returns a hash value for the page that E refers to. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Frees the page that E refers to, along with its frame or swap
+   slot. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  page_free (hash_entry (e, struct page, hash_elem));
+}
+
+/* Frees page P, which has been removed from its supplemental
+   page table, along with its frame or swap slot.  If P is a
+   modified mapping of a file, writes it back first. */
+static void
+page_free (struct page *p)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+
+  /* Wait for any eviction in progress to finish. */
+  lock_acquire (&p->lock);
+  if (p->frame != NULL)
+    {
+      struct frame *f = p->frame;
+
+      /* Other mappings may keep a shared frame in memory, so
+         write our changes to the file now. */
+      pagedir_clear_page (pd, p->upage);
+      if (p->shared && pagedir_is_dirty (pd, p->upage))
+        inode_write_at (f->inode, f->kpage, f->length, f->ofs);
+      frame_release (f, p);
+    }
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  lock_release (&p->lock);
+  free (p);
+}
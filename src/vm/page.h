@@ -0,0 +1,83 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include <list.h>
+#include "threads/synch.h"
+
+struct frame;
+struct thread;
+
+/* Default maximum size of a user stack, in bytes. */
+#define STACK_LIMIT_DEFAULT (8 * 1024 * 1024)
+
+/* Number of unmapped pages kept below the user stack. */
+#define STACK_GUARD_PAGES 16
+
+/* Maximum number of stack pages brought in by one fault. */
+#define STACK_PREFAULT 8
+
+/* Default number of pages in the fault-around window. */
+#define FAULT_AROUND_DEFAULT 16
+
+/* Maximum size of a user stack, in bytes. */
+extern size_t stack_limit;
+
+/* Number of pages in the fault-around window. */
+extern size_t fault_around_pages;
+
+/* A page of user virtual memory in the supplemental page table.
+
+   Each process keeps one of these for every page of its address
+   space, whether or not the page is currently mapped, so that a
+   page fault can find out where the page's contents come from. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct thread *owner;       /* Thread whose address space has the page. */
+    bool writable;              /* Read/write if true, read-only if false. */
+    struct hash_elem hash_elem; /* Element in thread's `pages' table. */
+
+    /* Where the page currently is.  Protected by LOCK. */
+    struct lock lock;           /* Serializes loading and eviction. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    struct list_elem frame_elem; /* Element in frame's `pages' list. */
+    size_t swap_slot;           /* Swap slot holding the page, or SWAP_NONE. */
+    bool dirty;                 /* Modified, even if the PTE says not. */
+    bool referenced;            /* Accessed before last working set sample. */
+
+    /* Source of the page's initial contents.  The first
+       READ_BYTES bytes are read from FILE at offset FILE_OFS and
+       the rest of the page is zeroed.  FILE is null for pages
+       that are entirely zero.  Once the page has been modified,
+       its contents come from swap instead, unless SHARED is
+       true, in which case the page is a mapping of FILE: it is
+       shared with other mappings through the page cache and
+       modifications are written back to FILE. */
+    struct file *file;          /* File, or null. */
+    off_t file_ofs;             /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read from FILE. */
+    bool shared;                /* Mapping of FILE? */
+  };
+
+bool page_table_init (void);
+void page_table_destroy (void);
+bool page_table_copy (struct thread *parent);
+
+struct page *page_lookup (const void *uaddr);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_shared (void *upage, struct file *, off_t ofs,
+                      size_t read_bytes, bool writable);
+void page_prefault (void *upage);
+void page_remove (void *upage);
+bool page_load (const void *fault_addr, bool write);
+bool page_grow_stack (const void *fault_addr, const void *esp);
+bool page_copy_on_write (const void *fault_addr);
+void page_out (struct frame *[], size_t cnt);
+
+#endif /* vm/page.h */
@@ -0,0 +1,368 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <lz.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Swap space.
+
+   The swap block device is divided into page-size "slots" of
+   SECTORS_PER_PAGE consecutive sectors each.  A bitmap records
+   which slots are in use, and for each used slot we remember
+   which thread's page it holds.
+
+   Eviction hands us up to SWAP_CLUSTER pages at once, which we
+   write into a single run of adjacent slots so that the disk
+   sees one sequential write.  Because those pages were evicted
+   together they are likely to be wanted together again, so
+   page_load() uses swap_get_page() to find neighbouring slots
+   of the same process and reads them in the same run.
+
+   Programmed I/O to the swap disk is slow, so a page going to
+   swap is first compressed into a pool of kernel memory of at
+   most swap_pool_limit bytes.  It is written to its slot on disk
+   only if the pool is full or if it does not compress to
+   ZSWAP_MAX_SIZE bytes or less.  A slot whose page is in the
+   pool still keeps its place on disk, so that swap space never
+   runs out later than it would without the pool.
+
+   A page read back in from disk keeps its slot, so that it can
+   be evicted again without a write as long as it stays clean.
+   A page read back in from the pool gives up its slot and its
+   compressed copy instead, unless another page shares the slot,
+   so that the pool only holds pages that are out of memory. */
+
+/* Number of sectors in a page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Largest compressed page that is kept in the pool. */
+#define ZSWAP_MAX_SIZE (PGSIZE * 3 / 4)
+
+/* Owner and contents of a swap slot.  A slot shared by several
+   pages after fork() has no owner. */
+struct slot
+  {
+    struct thread *owner;       /* Thread that owns PAGE, or null. */
+    struct page *page;          /* Page stored in the slot, or null. */
+    unsigned ref_cnt;           /* Number of pages using the slot. */
+    void *zdata;                /* Compressed page, or null if on disk. */
+    size_t zsize;               /* Size of ZDATA in bytes. */
+  };
+
+/* Maximum number of bytes of compressed pages kept in memory.
+   Set with the -zs kernel command-line option. */
+size_t swap_pool_limit = SWAP_POOL_DEFAULT;
+
+static struct block *swap_device;   /* Swap device, or null if none. */
+static struct bitmap *swap_map;     /* Bitmap of used slots. */
+static struct slot *slot_table;     /* Owner of each used slot. */
+static size_t pool_size;            /* Bytes of compressed pages. */
+static uint16_t lz_table[LZ_TABLE_SIZE]; /* Compressor scratch space. */
+static uint8_t lz_buf[ZSWAP_MAX_SIZE]; /* Compressor output. */
+static struct lock swap_lock;       /* Protects the above. */
+
+/* Statistics. */
+static long long out_pages, out_runs;   /* Pages written, write runs. */
+static long long in_pages, in_runs;     /* Pages read, read runs. */
+static long long zout_pages, zout_bytes; /* Pages compressed, their size. */
+static long long zin_pages;             /* Pages decompressed. */
+static long long poor_cnt, full_cnt;    /* Pages sent to disk, and why. */
+
+static void store_run (void *kpages[], size_t cnt, size_t slots[]);
+static bool compress_page (const void *kpage, size_t slot);
+static void write_run (void *kpages[], size_t cnt, size_t slots[]);
+
+/* Sets up swap space on the BLOCK_SWAP device, if there is one. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device != NULL)
+    slot_cnt = block_size (swap_device) / SECTORS_PER_PAGE;
+
+  swap_map = bitmap_create (slot_cnt);
+  slot_table = calloc (slot_cnt, sizeof *slot_table);
+  if (swap_map == NULL || (slot_table == NULL && slot_cnt > 0))
+    PANIC ("swap table creation failed");
+  printf ("swap: %zu slots available.\n", slot_cnt);
+}
+
+/* Writes the CNT pages in KPAGES to swap, storing the slot that
+   receives KPAGES[i], on behalf of PAGES[i], in SLOTS[i], or
+   SWAP_NONE if swap space is full.  The pages are given a single
+   run of adjacent slots if one is free, otherwise as few runs as
+   possible. */
+void
+swap_out (void *kpages[], struct page *pages[], size_t cnt,
+          size_t slots[])
+{
+  size_t first;
+  size_t i;
+
+  if (cnt == 0)
+    return;
+
+  lock_acquire (&swap_lock);
+  first = bitmap_scan_and_flip (swap_map, 0, cnt, false);
+  if (first != BITMAP_ERROR)
+    for (i = 0; i < cnt; i++) 
+      {
+        slot_table[first + i].owner = pages[i]->owner;
+        slot_table[first + i].page = pages[i];
+        slot_table[first + i].ref_cnt = 1;
+      }
+  lock_release (&swap_lock);
+
+  if (first != BITMAP_ERROR)
+    {
+      for (i = 0; i < cnt; i++)
+        slots[i] = first + i;
+      store_run (kpages, cnt, slots);
+    }
+  else if (cnt > 1)
+    {
+      /* No run is long enough.  Split in half and try again. */
+      swap_out (kpages, pages, cnt / 2, slots);
+      swap_out (kpages + cnt / 2, pages + cnt / 2, cnt - cnt / 2,
+                slots + cnt / 2);
+    }
+  else
+    slots[0] = SWAP_NONE;
+}
+
+/* Reads the CNT adjacent swap slots starting at SLOT into the
+   pages in KPAGES.  The slots stay allocated until freed with
+   swap_free() or swap_reclaim(). */
+void
+swap_in (size_t slot, void *kpages[], size_t cnt)
+{
+  size_t disk_cnt = 0;
+  size_t i, j;
+
+  for (i = 0; i < cnt; i++, slot++)
+    {
+      void *zdata;
+      size_t zsize;
+
+      /* The caller's page holds a reference to the slot, so its
+         compressed copy cannot go away under us. */
+      lock_acquire (&swap_lock);
+      zdata = slot_table[slot].zdata;
+      zsize = slot_table[slot].zsize;
+      lock_release (&swap_lock);
+
+      if (zdata != NULL)
+        {
+          size_t size = lz_decompress (zdata, zsize, kpages[i], PGSIZE);
+          ASSERT (size == PGSIZE);
+        }
+      else
+        {
+          block_sector_t sector = slot * SECTORS_PER_PAGE;
+          for (j = 0; j < SECTORS_PER_PAGE; j++)
+            block_read (swap_device, sector++,
+                        (uint8_t *) kpages[i] + j * BLOCK_SECTOR_SIZE);
+          disk_cnt++;
+        }
+    }
+
+  lock_acquire (&swap_lock);
+  in_pages += disk_cnt;
+  if (disk_cnt > 0)
+    in_runs++;
+  zin_pages += cnt - disk_cnt;
+  lock_release (&swap_lock);
+}
+
+/* Frees swap slot SLOT, which has just been read back in, along
+   with its compressed copy, if its page was in the pool and no
+   other page uses the slot.  Returns true if the slot was freed,
+   in which case the caller's page must forget it and must be
+   treated as dirty.  Otherwise returns false. */
+bool
+swap_reclaim (size_t slot)
+{
+  bool reclaimed = false;
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  if (slot_table[slot].zdata != NULL && slot_table[slot].ref_cnt == 1)
+    {
+      bitmap_reset (swap_map, slot);
+      slot_table[slot].owner = NULL;
+      slot_table[slot].page = NULL;
+      slot_table[slot].ref_cnt = 0;
+      free (slot_table[slot].zdata);
+      slot_table[slot].zdata = NULL;
+      pool_size -= slot_table[slot].zsize;
+      reclaimed = true;
+    }
+  lock_release (&swap_lock);
+  return reclaimed;
+}
+
+/* Returns the page stored in swap slot SLOT if it belongs to
+   OWNER, otherwise a null pointer. */
+struct page *
+swap_get_page (size_t slot, struct thread *owner)
+{
+  struct page *page = NULL;
+
+  lock_acquire (&swap_lock);
+  if (slot < bitmap_size (swap_map) && bitmap_test (swap_map, slot)
+      && slot_table[slot].owner == owner)
+    page = slot_table[slot].page;
+  lock_release (&swap_lock);
+  return page;
+}
+
+/* Adds a page to the users of swap slot SLOT.  The slot stays
+   allocated until each user frees it with swap_free(). */
+void
+swap_dup (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  slot_table[slot].ref_cnt++;
+
+  /* Neither page is the slot's sole owner any more, so neither
+     may read it ahead on behalf of the other. */
+  slot_table[slot].owner = NULL;
+  slot_table[slot].page = NULL;
+  lock_release (&swap_lock);
+}
+
+/* Removes a page from the users of swap slot SLOT, marking the
+   slot free if it was the last one. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  if (--slot_table[slot].ref_cnt == 0)
+    {
+      bitmap_reset (swap_map, slot);
+      slot_table[slot].owner = NULL;
+      slot_table[slot].page = NULL;
+      if (slot_table[slot].zdata != NULL)
+        {
+          free (slot_table[slot].zdata);
+          slot_table[slot].zdata = NULL;
+          pool_size -= slot_table[slot].zsize;
+        }
+    }
+  lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  long long secs = timer_ticks () / TIMER_FREQ;
+
+  if (secs == 0)
+    secs = 1;
+  printf ("Swap: %lld pages out (%lld/s) in %lld writes, "
+          "%lld pages in (%lld/s) in %lld reads\n",
+          out_pages, out_pages / secs, out_runs,
+          in_pages, in_pages / secs, in_runs);
+  printf ("Swap: average write %lld bytes, average read %lld bytes\n",
+          out_runs > 0 ? out_pages * PGSIZE / out_runs : 0,
+          in_runs > 0 ? in_pages * PGSIZE / in_runs : 0);
+  printf ("Swap: %lld pages compressed to %lld%% of their size, "
+          "%lld compressed poorly, %lld found the pool full\n",
+          zout_pages,
+          zout_pages > 0 ? zout_bytes * 100 / (zout_pages * PGSIZE) : 0,
+          poor_cnt, full_cnt);
+  printf ("Swap: %lld of %lld pages in from memory (%lld%%), "
+          "%zu bytes in pool\n",
+          zin_pages, zin_pages + in_pages,
+          zin_pages + in_pages > 0
+          ? zin_pages * 100 / (zin_pages + in_pages) : 0,
+          pool_size);
+}
+
+/* Stores the CNT pages in KPAGES in the adjacent slots in SLOTS,
+   in order: in the compressed pool if possible, otherwise on
+   disk, with adjacent pages that go to disk written together. */
+static void
+store_run (void *kpages[], size_t cnt, size_t slots[])
+{
+  size_t run = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (compress_page (kpages[i], slots[i]))
+      {
+        if (run < i)
+          write_run (kpages + run, i - run, slots + run);
+        run = i + 1;
+      }
+  if (run < cnt)
+    write_run (kpages + run, cnt - run, slots + run);
+}
+
+/* Tries to store KPAGE in the compressed pool as the contents of
+   SLOT.  Returns true if successful, false if the page must go
+   to disk instead. */
+static bool
+compress_page (const void *kpage, size_t slot)
+{
+  bool stored = false;
+  size_t zsize;
+
+  lock_acquire (&swap_lock);
+  zsize = lz_compress (kpage, PGSIZE, lz_buf, sizeof lz_buf, lz_table);
+  if (zsize == 0)
+    poor_cnt++;
+  else if (pool_size + zsize > swap_pool_limit)
+    full_cnt++;
+  else
+    {
+      void *zdata = malloc (zsize);
+      if (zdata != NULL)
+        {
+          memcpy (zdata, lz_buf, zsize);
+          slot_table[slot].zdata = zdata;
+          slot_table[slot].zsize = zsize;
+          pool_size += zsize;
+          zout_pages++;
+          zout_bytes += zsize;
+          stored = true;
+        }
+      else
+        full_cnt++;
+    }
+  lock_release (&swap_lock);
+  return stored;
+}
+
+/* Writes the CNT pages in KPAGES to the adjacent slots in SLOTS,
+   in order. */
+static void
+write_run (void *kpages[], size_t cnt, size_t slots[])
+{
+  block_sector_t sector = slots[0] * SECTORS_PER_PAGE;
+  size_t i, j;
+
+  for (i = 0; i < cnt; i++)
+    for (j = 0; j < SECTORS_PER_PAGE; j++)
+      block_write (swap_device, sector++,
+                   (const uint8_t *) kpages[i] + j * BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&swap_lock);
+  out_pages += cnt;
+  out_runs++;
+  lock_release (&swap_lock);
+}
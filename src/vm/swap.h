@@ -0,0 +1,36 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct page;
+struct thread;
+
+/* Swap slot index that refers to no slot. */
+#define SWAP_NONE SIZE_MAX
+
+/* Maximum number of pages written to swap in one run. */
+#define SWAP_CLUSTER 8
+
+/* Maximum number of pages read from swap in one run. */
+#define SWAP_READAHEAD 4
+
+/* Default size of the pool of compressed pages, in bytes. */
+#define SWAP_POOL_DEFAULT (256 * 1024)
+
+/* Maximum size of the pool of compressed pages, in bytes. */
+extern size_t swap_pool_limit;
+
+void swap_init (void);
+void swap_out (void *kpages[], struct page *[], size_t cnt,
+               size_t slots[]);
+void swap_in (size_t slot, void *kpages[], size_t cnt);
+bool swap_reclaim (size_t slot);
+struct page *swap_get_page (size_t slot, struct thread *owner);
+void swap_dup (size_t slot);
+void swap_free (size_t slot);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */